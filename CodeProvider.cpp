@@ -0,0 +1,125 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "CodeProvider.h"
+
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool
+CodeProvider::open(const char* path)
+{
+    close();
+
+#ifdef HAVE_MMAP
+    int fd = ::open(path, O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                _map = reinterpret_cast<const uint8_t*>(map);
+                _size = uint32_t(st.st_size);
+            }
+        }
+
+        // The mapping stays valid after the file is closed
+        ::close(fd);
+        if (_map) {
+            return true;
+        }
+    }
+#endif
+
+    // Fall back to reading pages into the cache
+    _file = fopen(path, "rb");
+    if (!_file) {
+        return false;
+    }
+
+    fseek(_file, 0, SEEK_END);
+    _size = uint32_t(ftell(_file));
+    return true;
+}
+
+void
+CodeProvider::close()
+{
+#ifdef HAVE_MMAP
+    if (_map) {
+        munmap(const_cast<uint8_t*>(_map), _size);
+    }
+#endif
+    if (_file) {
+        fclose(_file);
+    }
+
+    _map = nullptr;
+    _file = nullptr;
+    _size = 0;
+
+    for (Page& page : _pages) {
+        page.addr = NoPage;
+    }
+    _lastPage = 0;
+    _nextVictim = 0;
+}
+
+uint8_t
+CodeProvider::missByte(uint32_t addr)
+{
+    if (addr >= _size || !_file) {
+        return 0;
+    }
+
+    uint32_t pageAddr = addr / PageSize * PageSize;
+
+    for (uint8_t i = 0; i < NumPages; ++i) {
+        if (_pages[i].addr == pageAddr) {
+            _lastPage = i;
+            return _pages[i].data[addr - pageAddr];
+        }
+    }
+
+    // Not cached. Replace pages round robin, which is as good as LRU for
+    // code which mostly runs in a few tight loops and is much cheaper
+    _stats.misses++;
+
+    _lastPage = _nextVictim;
+    if (++_nextVictim >= NumPages) {
+        _nextVictim = 0;
+    }
+
+    Page& page = _pages[_lastPage];
+    page.addr = pageAddr;
+
+    fseek(_file, pageAddr, SEEK_SET);
+    size_t n = fread(page.data, 1, PageSize, _file);
+    memset(page.data + n, 0, PageSize - n);
+
+    return page.data[addr - pageAddr];
+}
+
+std::string
+CodeProvider::statsString() const
+{
+    uint32_t hitPercent = _stats.fetches ? uint32_t(uint64_t(_stats.fetches - _stats.misses) * 100 / _stats.fetches) : 0;
+    return std::string(mapped() ? "mapped" : "cached")
+         + " size=" + std::to_string(_size)
+         + " fetches=" + std::to_string(_stats.fetches)
+         + " misses=" + std::to_string(_stats.misses)
+         + " hit=" + std::to_string(hitPercent) + "%";
+}
@@ -0,0 +1,95 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// CodeProvider Class
+//
+// Supplies Clover code bytes to the interpreter from an executable image
+// (e.g., executable.clvx). Where the platform has mmap the whole image is
+// mapped and a fetch is just an array access. Elsewhere the file is read
+// a page at a time into a small RAM cache. Hits and misses are counted so
+// the cache can be sized.
+//
+// Pass getCodeByte as the interpreter's GetCodeByteCB, with the
+// CodeProvider as its data.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+class CodeProvider
+{
+public:
+    static constexpr uint16_t PageSize = 64;
+    static constexpr uint8_t NumPages = 8;
+
+    struct Stats
+    {
+        uint32_t fetches = 0;
+        uint32_t misses = 0;
+    };
+
+    CodeProvider() { }
+    ~CodeProvider() { close(); }
+
+    // Returns false if the image can't be opened
+    bool open(const char* path);
+    void close();
+
+    bool mapped() const { return _map != nullptr; }
+    uint32_t size() const { return _size; }
+
+    // Bytes past the end of the image are 0
+    uint8_t byte(uint32_t addr)
+    {
+        _stats.fetches++;
+
+        if (_map) {
+            return (addr < _size) ? _map[addr] : 0;
+        }
+
+        // Code is mostly fetched sequentially, so check the last page first
+        Page& page = _pages[_lastPage];
+        if (page.addr == addr / PageSize * PageSize) {
+            return page.data[addr - page.addr];
+        }
+        return missByte(addr);
+    }
+
+    static uint8_t getCodeByte(uint32_t addr, void* data)
+    {
+        return reinterpret_cast<CodeProvider*>(data)->byte(addr);
+    }
+
+    const Stats& stats() const { return _stats; }
+    void clearStats() { _stats = Stats(); }
+    std::string statsString() const;
+
+private:
+    static constexpr uint32_t NoPage = 0xffffffff;
+
+    struct Page
+    {
+        uint32_t addr = NoPage;
+        uint8_t data[PageSize];
+    };
+
+    uint8_t missByte(uint32_t addr);
+
+    const uint8_t* _map = nullptr;
+    FILE* _file = nullptr;
+    uint32_t _size = 0;
+
+    Page _pages[NumPages];
+    uint8_t _lastPage = 0;
+    uint8_t _nextVictim = 0;
+
+    Stats _stats;
+};
@@ -0,0 +1,158 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "ColorConvert.h"
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define COLOR_TABLE PROGMEM
+static inline uint8_t tableByte(const uint8_t* p) { return pgm_read_byte(p); }
+#else
+#define COLOR_TABLE
+static inline uint8_t tableByte(const uint8_t* p) { return *p; }
+#endif
+
+// Fully saturated, full value r, g, b for each 8 bit hue. This is the
+// same math as Adafruit_NeoPixel::ColorHSV with the hue multiplied by 256
+static const uint8_t HueTable[256][3] COLOR_TABLE =
+{
+    { 255,   0,   0 }, { 255,   6,   0 }, { 255,  12,   0 }, { 255,  18,   0 },
+    { 255,  24,   0 }, { 255,  30,   0 }, { 255,  36,   0 }, { 255,  42,   0 },
+    { 255,  48,   0 }, { 255,  54,   0 }, { 255,  60,   0 }, { 255,  66,   0 },
+    { 255,  72,   0 }, { 255,  78,   0 }, { 255,  84,   0 }, { 255,  90,   0 },
+    { 255,  96,   0 }, { 255, 102,   0 }, { 255, 108,   0 }, { 255, 114,   0 },
+    { 255, 120,   0 }, { 255, 126,   0 }, { 255, 131,   0 }, { 255, 137,   0 },
+    { 255, 143,   0 }, { 255, 149,   0 }, { 255, 155,   0 }, { 255, 161,   0 },
+    { 255, 167,   0 }, { 255, 173,   0 }, { 255, 179,   0 }, { 255, 185,   0 },
+    { 255, 191,   0 }, { 255, 197,   0 }, { 255, 203,   0 }, { 255, 209,   0 },
+    { 255, 215,   0 }, { 255, 221,   0 }, { 255, 227,   0 }, { 255, 233,   0 },
+    { 255, 239,   0 }, { 255, 245,   0 }, { 255, 251,   0 }, { 253, 255,   0 },
+    { 247, 255,   0 }, { 241, 255,   0 }, { 235, 255,   0 }, { 229, 255,   0 },
+    { 223, 255,   0 }, { 217, 255,   0 }, { 211, 255,   0 }, { 205, 255,   0 },
+    { 199, 255,   0 }, { 193, 255,   0 }, { 187, 255,   0 }, { 181, 255,   0 },
+    { 175, 255,   0 }, { 169, 255,   0 }, { 163, 255,   0 }, { 157, 255,   0 },
+    { 151, 255,   0 }, { 145, 255,   0 }, { 139, 255,   0 }, { 133, 255,   0 },
+    { 127, 255,   0 }, { 122, 255,   0 }, { 116, 255,   0 }, { 110, 255,   0 },
+    { 104, 255,   0 }, {  98, 255,   0 }, {  92, 255,   0 }, {  86, 255,   0 },
+    {  80, 255,   0 }, {  74, 255,   0 }, {  68, 255,   0 }, {  62, 255,   0 },
+    {  56, 255,   0 }, {  50, 255,   0 }, {  44, 255,   0 }, {  38, 255,   0 },
+    {  32, 255,   0 }, {  26, 255,   0 }, {  20, 255,   0 }, {  14, 255,   0 },
+    {   8, 255,   0 }, {   2, 255,   0 }, {   0, 255,   4 }, {   0, 255,  10 },
+    {   0, 255,  16 }, {   0, 255,  22 }, {   0, 255,  28 }, {   0, 255,  34 },
+    {   0, 255,  40 }, {   0, 255,  46 }, {   0, 255,  52 }, {   0, 255,  58 },
+    {   0, 255,  64 }, {   0, 255,  70 }, {   0, 255,  76 }, {   0, 255,  82 },
+    {   0, 255,  88 }, {   0, 255,  94 }, {   0, 255, 100 }, {   0, 255, 106 },
+    {   0, 255, 112 }, {   0, 255, 118 }, {   0, 255, 124 }, {   0, 255, 129 },
+    {   0, 255, 135 }, {   0, 255, 141 }, {   0, 255, 147 }, {   0, 255, 153 },
+    {   0, 255, 159 }, {   0, 255, 165 }, {   0, 255, 171 }, {   0, 255, 177 },
+    {   0, 255, 183 }, {   0, 255, 189 }, {   0, 255, 195 }, {   0, 255, 201 },
+    {   0, 255, 207 }, {   0, 255, 213 }, {   0, 255, 219 }, {   0, 255, 225 },
+    {   0, 255, 231 }, {   0, 255, 237 }, {   0, 255, 243 }, {   0, 255, 249 },
+    {   0, 255, 255 }, {   0, 249, 255 }, {   0, 243, 255 }, {   0, 237, 255 },
+    {   0, 231, 255 }, {   0, 225, 255 }, {   0, 219, 255 }, {   0, 213, 255 },
+    {   0, 207, 255 }, {   0, 201, 255 }, {   0, 195, 255 }, {   0, 189, 255 },
+    {   0, 183, 255 }, {   0, 177, 255 }, {   0, 171, 255 }, {   0, 165, 255 },
+    {   0, 159, 255 }, {   0, 153, 255 }, {   0, 147, 255 }, {   0, 141, 255 },
+    {   0, 135, 255 }, {   0, 129, 255 }, {   0, 124, 255 }, {   0, 118, 255 },
+    {   0, 112, 255 }, {   0, 106, 255 }, {   0, 100, 255 }, {   0,  94, 255 },
+    {   0,  88, 255 }, {   0,  82, 255 }, {   0,  76, 255 }, {   0,  70, 255 },
+    {   0,  64, 255 }, {   0,  58, 255 }, {   0,  52, 255 }, {   0,  46, 255 },
+    {   0,  40, 255 }, {   0,  34, 255 }, {   0,  28, 255 }, {   0,  22, 255 },
+    {   0,  16, 255 }, {   0,  10, 255 }, {   0,   4, 255 }, {   2,   0, 255 },
+    {   8,   0, 255 }, {  14,   0, 255 }, {  20,   0, 255 }, {  26,   0, 255 },
+    {  32,   0, 255 }, {  38,   0, 255 }, {  44,   0, 255 }, {  50,   0, 255 },
+    {  56,   0, 255 }, {  62,   0, 255 }, {  68,   0, 255 }, {  74,   0, 255 },
+    {  80,   0, 255 }, {  86,   0, 255 }, {  92,   0, 255 }, {  98,   0, 255 },
+    { 104,   0, 255 }, { 110,   0, 255 }, { 116,   0, 255 }, { 122,   0, 255 },
+    { 128,   0, 255 }, { 133,   0, 255 }, { 139,   0, 255 }, { 145,   0, 255 },
+    { 151,   0, 255 }, { 157,   0, 255 }, { 163,   0, 255 }, { 169,   0, 255 },
+    { 175,   0, 255 }, { 181,   0, 255 }, { 187,   0, 255 }, { 193,   0, 255 },
+    { 199,   0, 255 }, { 205,   0, 255 }, { 211,   0, 255 }, { 217,   0, 255 },
+    { 223,   0, 255 }, { 229,   0, 255 }, { 235,   0, 255 }, { 241,   0, 255 },
+    { 247,   0, 255 }, { 253,   0, 255 }, { 255,   0, 251 }, { 255,   0, 245 },
+    { 255,   0, 239 }, { 255,   0, 233 }, { 255,   0, 227 }, { 255,   0, 221 },
+    { 255,   0, 215 }, { 255,   0, 209 }, { 255,   0, 203 }, { 255,   0, 197 },
+    { 255,   0, 191 }, { 255,   0, 185 }, { 255,   0, 179 }, { 255,   0, 173 },
+    { 255,   0, 167 }, { 255,   0, 161 }, { 255,   0, 155 }, { 255,   0, 149 },
+    { 255,   0, 143 }, { 255,   0, 137 }, { 255,   0, 131 }, { 255,   0, 126 },
+    { 255,   0, 120 }, { 255,   0, 114 }, { 255,   0, 108 }, { 255,   0, 102 },
+    { 255,   0,  96 }, { 255,   0,  90 }, { 255,   0,  84 }, { 255,   0,  78 },
+    { 255,   0,  72 }, { 255,   0,  66 }, { 255,   0,  60 }, { 255,   0,  54 },
+    { 255,   0,  48 }, { 255,   0,  42 }, { 255,   0,  36 }, { 255,   0,  30 },
+    { 255,   0,  24 }, { 255,   0,  18 }, { 255,   0,  12 }, { 255,   0,   6 },
+};
+
+// Gamma 2.6, same as Adafruit_NeoPixel::gamma8
+static const uint8_t GammaTable[256] COLOR_TABLE =
+{
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,   2,   3,   3,   3,   3,
+      3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   5,   6,   6,   6,   6,   7,
+      7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  10,  11,  11,  11,  12,  12,
+     13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,  20,
+     20,  21,  21,  22,  22,  23,  24,  24,  25,  25,  26,  27,  27,  28,  29,  29,
+     30,  31,  31,  32,  33,  34,  34,  35,  36,  37,  38,  38,  39,  40,  41,  42,
+     42,  43,  44,  45,  46,  47,  48,  49,  50,  51,  52,  53,  54,  55,  56,  57,
+     58,  59,  60,  61,  62,  63,  64,  65,  66,  68,  69,  70,  71,  72,  73,  75,
+     76,  77,  78,  80,  81,  82,  84,  85,  86,  88,  89,  90,  92,  93,  94,  96,
+     97,  99, 100, 102, 103, 105, 106, 108, 109, 111, 112, 114, 115, 117, 119, 120,
+    122, 124, 125, 127, 129, 130, 132, 134, 136, 137, 139, 141, 143, 145, 146, 148,
+    150, 152, 154, 156, 158, 160, 162, 164, 166, 168, 170, 172, 174, 176, 178, 180,
+    182, 184, 186, 188, 191, 193, 195, 197, 199, 202, 204, 206, 209, 211, 213, 215,
+    218, 220, 223, 225, 227, 230, 232, 235, 237, 240, 242, 245, 247, 250, 252, 255,
+};
+
+// R, G, B are the byte offsets of each component in an output pixel
+template<uint8_t R, uint8_t G, uint8_t B>
+static void convert(const ColorConvert::HSV* hsv, uint8_t* pixels, uint16_t count)
+{
+    // This follows ColorHSV: c = (((c * s1) >> 8) + s2) * v1 >> 8, all
+    // in 16 bit fixed point, followed by a gamma lookup
+    for (uint16_t i = 0; i < count; ++i) {
+        const uint8_t* hue = HueTable[hsv[i].h];
+        uint16_t s1 = uint16_t(hsv[i].s) + 1;
+        uint16_t s2 = 255 - hsv[i].s;
+        uint16_t v1 = uint16_t(hsv[i].v) + 1;
+
+        uint8_t* p = pixels + i * 3;
+        p[R] = tableByte(&GammaTable[((((tableByte(&hue[0]) * s1) >> 8) + s2) * v1) >> 8]);
+        p[G] = tableByte(&GammaTable[((((tableByte(&hue[1]) * s1) >> 8) + s2) * v1) >> 8]);
+        p[B] = tableByte(&GammaTable[((((tableByte(&hue[2]) * s1) >> 8) + s2) * v1) >> 8]);
+    }
+}
+
+void
+ColorConvert::hsvToPixels(const HSV* hsv, uint8_t* pixels, uint16_t count, Order order)
+{
+    if (order == Order::GRB) {
+        convert<1, 0, 2>(hsv, pixels, count);
+    } else {
+        convert<0, 1, 2>(hsv, pixels, count);
+    }
+}
+
+void
+ColorConvert::hsvToRGB(uint8_t h, uint8_t s, uint8_t v, uint8_t& r, uint8_t& g, uint8_t& b)
+{
+    HSV hsv = { h, s, v };
+    uint8_t pixel[3];
+    convert<0, 1, 2>(&hsv, pixel, 1);
+    r = pixel[0];
+    g = pixel[1];
+    b = pixel[2];
+}
+
+uint32_t
+ColorConvert::hsvToColor(uint8_t h, uint8_t s, uint8_t v)
+{
+    uint8_t r, g, b;
+    hsvToRGB(h, s, v, r, g, b);
+    return (uint32_t(r) << 16) | (uint32_t(g) << 8) | uint32_t(b);
+}
@@ -0,0 +1,39 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// ColorConvert Class
+//
+// Table driven HSV to gamma corrected RGB conversion. Hue, saturation
+// and value are all 0-255, the same as the command params. A whole
+// span of HSV values can be converted to wire-ready pixels in one call.
+
+#pragma once
+
+#include <stdint.h>
+
+class ColorConvert
+{
+public:
+    struct HSV
+    {
+        uint8_t h;
+        uint8_t s;
+        uint8_t v;
+    };
+
+    // Byte order of each 3 byte output pixel
+    enum class Order { RGB, GRB };
+
+    static void hsvToPixels(const HSV* hsv, uint8_t* pixels, uint16_t count, Order order = Order::RGB);
+
+    static void hsvToRGB(uint8_t h, uint8_t s, uint8_t v, uint8_t& r, uint8_t& g, uint8_t& b);
+
+    // Returns 0x00RRGGBB
+    static uint32_t hsvToColor(uint8_t h, uint8_t s, uint8_t v);
+};
@@ -0,0 +1,235 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "CommandBatch.h"
+
+#include "System.h"
+
+#include <cstring>
+
+static const char* TAG = "CommandBatch";
+
+// Parse a decimal number at index. Returns -1 if there isn't one
+static int32_t parseNumber(const char* str, size_t length, size_t& index)
+{
+    if (index >= length || str[index] < '0' || str[index] > '9') {
+        return -1;
+    }
+
+    int32_t value = 0;
+    while (index < length && str[index] >= '0' && str[index] <= '9') {
+        value = value * 10 + (str[index++] - '0');
+        if (value > 0xffff) {
+            return -1;
+        }
+    }
+    return value;
+}
+
+CommandBatch::Command&
+CommandBatch::newCommand(uint16_t numPosts)
+{
+    // Missing params are 0
+    Command& command = _commands[_count];
+    memset(command.buf, 0, MaxCmdSize);
+    command.size = 0;
+    command.firstPost = 0;
+    command.numPosts = numPosts;
+    return command;
+}
+
+void
+CommandBatch::set(const uint8_t* buf, uint16_t size, uint16_t numPosts)
+{
+    _count = 0;
+    Command& command = newCommand(numPosts);
+    command.size = (size < MaxCmdSize) ? size : MaxCmdSize;
+    memcpy(command.buf, buf, command.size);
+    _count = 1;
+}
+
+bool
+CommandBatch::parse(const char* cmds, size_t length, uint16_t numPosts)
+{
+    _count = 0;
+    
+    // HACK ALERT: On espidf string.length includes the terminating null
+    while (length > 0 && cmds[length - 1] == '\0') {
+        --length;
+    }
+
+    size_t start = 0;
+
+    while (start < length) {
+        size_t end = start;
+        while (end < length && cmds[end] != ';') {
+            ++end;
+        }
+
+        if (end > start) {
+            if (_count >= MaxCommands) {
+                mil::System::logE(TAG, "parse: more than %d commands", int(MaxCommands));
+                _count = 0;
+                return false;
+            }
+
+            Command& command = newCommand(numPosts);
+
+            const char* cmd = cmds + start;
+            size_t cmdLength = end - start;
+            
+            size_t colon = 0;
+            while (colon < cmdLength && cmd[colon] != ':') {
+                ++colon;
+            }
+            
+            if (colon < cmdLength) {
+                size_t index = 0;
+                int32_t first = parseNumber(cmd, colon, index);
+                int32_t last = first;
+                if (index < colon && cmd[index] == '-') {
+                    index++;
+                    last = parseNumber(cmd, colon, index);
+                }
+
+                if (index != colon || first < 1 || last < first || last > numPosts) {
+                    mil::System::logE(TAG, "parse: bad posts in command %d", int(_count));
+                    _count = 0;
+                    return false;
+                }
+
+                command.firstPost = first - 1;
+                command.numPosts = last - first + 1;
+                cmd += colon + 1;
+                cmdLength -= colon + 1;
+            }
+
+            int16_t size = parseCmd(cmd, cmdLength, command.buf, MaxCmdSize);
+            if (size <= 0) {
+                _count = 0;
+                return false;
+            }
+            command.size = size;
+            _count++;
+        }
+
+        start = end + 1;
+    }
+
+    return _count > 0;
+}
+
+bool
+CommandBatch::parseBinary(const uint8_t* buf, size_t length, uint16_t numPosts)
+{
+    _count = 0;
+    size_t index = 0;
+    
+    while (index < length) {
+        // HACK ALERT: On espidf string.length includes the terminating null.
+        // A command's last param can be 0, so only a lone 0 after the last
+        // command is taken to be it
+        if (length - index == 1 && buf[index] == '\0' && _count > 0) {
+            break;
+        }
+        
+        if (length - index < 5) {
+            mil::System::logE(TAG, "parseBinary: truncated header at %d", int(index));
+            _count = 0;
+            return false;
+        }
+        
+        uint16_t firstPost = (uint16_t(buf[index]) << 8) | buf[index + 1];
+        uint16_t postCount = (uint16_t(buf[index + 2]) << 8) | buf[index + 3];
+        uint8_t size = buf[index + 4];
+        index += 5;
+        
+        if (_count >= MaxCommands || size < 1 || size > MaxCmdSize || size > length - index) {
+            mil::System::logE(TAG, "parseBinary: bad command %d", int(_count));
+            _count = 0;
+            return false;
+        }
+        
+        Command& command = newCommand(numPosts);
+        
+        if (firstPost != 0) {
+            if (postCount < 1 || firstPost - 1 + postCount > numPosts) {
+                mil::System::logE(TAG, "parseBinary: bad posts in command %d", int(_count));
+                _count = 0;
+                return false;
+            }
+            command.firstPost = firstPost - 1;
+            command.numPosts = postCount;
+        }
+        
+        memcpy(command.buf, buf + index, size);
+        command.size = size;
+        index += size;
+        _count++;
+    }
+    
+    return _count > 0;
+}
+
+int16_t
+CommandBatch::parseCmd(const char* cmd, size_t length, uint8_t* buf, uint16_t size)
+{
+    // Cmd form is: <cmd char>,<param0 (0-255)>,<param1 (0-255)>,...<paramN (0-255)>
+    while (length > 0 && cmd[length - 1] == '\0') {
+        --length;
+    }
+
+    // Cmd must be a single char
+    if (length < 1 || size < 1 || (length > 1 && cmd[1] != ',')) {
+        mil::System::logE(TAG, "parseCmd: cmd must be a single char");
+        return -1;
+    }
+    
+    uint16_t bufIndex = 0;
+    buf[bufIndex++] = uint8_t(cmd[0]);
+    
+    size_t strIndex = 1;
+    while (strIndex < length) {
+        // Skip the ',' then parse param. Must be 1 to 3 digits <= 255
+        strIndex++;
+        
+        uint16_t param = 0;
+        uint16_t paramSize = 0;
+        while (strIndex < length && cmd[strIndex] != ',') {
+            uint16_t digit = uint16_t(cmd[strIndex]) - '0';
+            if (digit > 9) {
+                mil::System::logE(TAG, "parseCmd: digit out of range at index %d", int(strIndex));
+                return -1;
+            }
+            if (++paramSize > 3) {
+                mil::System::logE(TAG, "parseCmd: param must be 1 to 3 chars at index %d", int(strIndex));
+                return -1;
+            }
+            param = param * 10 + digit;
+            strIndex++;
+        }
+        
+        if (paramSize == 0) {
+            mil::System::logE(TAG, "parseCmd: param must be 1 to 3 chars at index %d", int(strIndex));
+            return -1;
+        }
+        
+        if (param > 255) {
+            param = 255;
+        }
+        
+        if (bufIndex >= size) {
+            mil::System::logE(TAG, "parseCmd: too many params at index %d", int(strIndex));
+            return -1;
+        }
+        buf[bufIndex++] = uint8_t(param);
+    }
+    
+    return bufIndex;
+}
@@ -0,0 +1,73 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// CommandBatch Class
+//
+// Parses a list of commands sent in a single request. Commands are
+// separated by ';'. Each can be preceded by the posts it applies to:
+//
+//      [<post>[-<lastPost>]:]<cmd char>,<param0>,<param1>,...
+//
+// Posts start at 1. With no post prefix the command applies to all posts.
+// For instance:
+//
+//      1-3:C,0,255,128,0,0;4-7:f,30,255,200,3
+//
+// makes the first 3 posts red and flickers the rest. A native effect
+// redraws its posts every frame, so its posts shouldn't overlap others.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+class CommandBatch
+{
+public:
+    static constexpr uint8_t MaxCommands = 8;
+    static constexpr uint16_t MaxCmdSize = 16;
+
+    struct Command
+    {
+        uint8_t buf[MaxCmdSize];
+        uint16_t size;
+        uint16_t firstPost; // 0 based
+        uint16_t numPosts;
+    };
+
+    // Returns false if any command is bad, in which case the batch is empty
+    bool parse(const char* cmds, size_t length, uint16_t numPosts);
+    bool parse(const std::string& cmds, uint16_t numPosts) { return parse(cmds.c_str(), cmds.size(), numPosts); }
+
+    // Binary form skips text parsing. Each command is:
+    //
+    //      <first post (1 based, 0 is all posts)> <post count> <size> <size bytes: cmd char, params>
+    //
+    // first post and post count are 16 bits, high byte first, since there
+    // can be more than 255 posts. They used to be a byte each, so senders
+    // of the old form must add a 0 before each.
+    bool parseBinary(const uint8_t* buf, size_t length, uint16_t numPosts);
+
+    // Make the batch a single command (from parseCmd) for all posts
+    void set(const uint8_t* buf, uint16_t size, uint16_t numPosts);
+
+    void clear() { _count = 0; }
+    uint8_t size() const { return _count; }
+    const Command& operator[](uint8_t i) const { return _commands[i]; }
+
+    // Parse a single command (without a post prefix) into buf. Returns the
+    // number of bytes in buf or -1 on error. Nothing is allocated.
+    static int16_t parseCmd(const char* cmd, size_t length, uint8_t* buf, uint16_t size);
+
+private:
+    Command& newCommand(uint16_t numPosts);
+
+    Command _commands[MaxCommands];
+    uint8_t _count = 0;
+};
@@ -0,0 +1,90 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// DirtyTracker Class
+//
+// Keeps track of which posts have changed since the last refresh and the
+// range of pixels that changed, so a refresh can be skipped when nothing
+// changed, or cut short after the last changed pixel. Also counts
+// refreshes which were done, skipped and shortened.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+class DirtyTracker
+{
+public:
+    // Topology::MaxPosts. Arduino builds only ever have one short strand
+#if defined ARDUINO
+    static constexpr uint16_t MaxPosts = 64;
+#else
+    static constexpr uint16_t MaxPosts = 512;
+#endif
+
+    struct Stats
+    {
+        uint32_t refreshes = 0;
+        uint32_t skipped = 0;
+        uint32_t shortened = 0;
+    };
+
+    DirtyTracker(uint16_t pixelsPerPost) : _pixelsPerPost(pixelsPerPost) { clear(); }
+
+    void setPixelsPerPost(uint16_t pixelsPerPost) { _pixelsPerPost = pixelsPerPost; clear(); }
+
+    void mark(uint16_t from, uint16_t count)
+    {
+        if (count == 0) {
+            return;
+        }
+
+        uint16_t to = from + count - 1;
+        if (from < _first) {
+            _first = from;
+        }
+        if (to > _last || _last == NotDirty) {
+            _last = to;
+        }
+
+        for (uint16_t post = from / _pixelsPerPost; post <= to / _pixelsPerPost && post < MaxPosts; ++post) {
+            _posts[post / 8] |= uint8_t(1 << (post % 8));
+        }
+    }
+
+    void clear()
+    {
+        _first = NotDirty;
+        _last = NotDirty;
+        memset(_posts, 0, sizeof(_posts));
+    }
+
+    bool dirty() const { return _last != NotDirty; }
+    bool postDirty(uint16_t post) const { return post < MaxPosts && (_posts[post / 8] & (1 << (post % 8))); }
+
+    // Range of changed pixels, only valid if dirty()
+    uint16_t first() const { return _first; }
+    uint16_t last() const { return _last; }
+
+    // Call these when refreshing
+    void refreshed(bool shortened) { _stats.refreshes++; if (shortened) _stats.shortened++; }
+    void skipped() { _stats.skipped++; }
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    static constexpr uint16_t NotDirty = 0xffff;
+
+    uint16_t _pixelsPerPost;
+    uint16_t _first;
+    uint16_t _last;
+    uint8_t _posts[(MaxPosts + 7) / 8];
+    Stats _stats;
+};
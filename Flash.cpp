@@ -9,14 +9,15 @@
 
 #include "Flash.h"
 
+#include "ColorConvert.h"
+#include "FrameBuffer.h"
 #include "PostLightController.h"
 #include "System.h"
 
 bool
 Flash::init(uint8_t h, uint8_t s, uint8_t v, uint8_t count, uint16_t duration)
 {
-    // Incoming hue is 0-255, hsvToRGB expects 0-65535
-    mil::Graphics::hsvToRGB(_red, _green, _blue, uint16_t(h) * 256, s, v);
+    ColorConvert::hsvToRGB(h, s, v, _red, _green, _blue);
 	_countCompleted = 0;
     _count = count;
     _duration = uint16_t(duration) * 100;
@@ -25,10 +26,10 @@ Flash::init(uint8_t h, uint8_t s, uint8_t v, uint8_t count, uint16_t duration)
     // If we will be flashing (count != 0) then start with the lights off.
     // Otherwise set the lights to the passed color
     if (count == 0) {
-        mil::System::setLEDs(1, 0, TotalPixels, _red, _green, _blue);
-        mil::System::refreshLEDs(1);
+        _frameBuffer->setLights(0, _frameBuffer->numPixels(), _red, _green, _blue);
+        _frameBuffer->show();
     } else {
-        mil::System::setLEDs(1, 0, TotalPixels, 0, 0, 0);
+        _frameBuffer->setLights(0, _frameBuffer->numPixels(), 0, 0, 0);
     }
 	return true;
 }
@@ -46,7 +47,7 @@ Flash::loop()
 	bool colorOn = false;
 	
 	if (_on) {
-		if (t > _lastFlash + _duration) {
+		if (t >= _lastFlash + _duration) {
 			colorOn = false;
 			showColor = true;
 			_lastFlash = t;
@@ -54,7 +55,7 @@ Flash::loop()
 			_countCompleted++;
 		}
 	} else {
-		if (t > _lastFlash + _duration) {
+		if (t >= _lastFlash + _duration) {
 			colorOn = true;
 			showColor = true;
 			_lastFlash = t;
@@ -64,12 +65,15 @@ Flash::loop()
 	
 	if (showColor) {
         if (colorOn) {
-            mil::System::setLEDs(1, 0, TotalPixels, _red, _green, _blue);
+            _frameBuffer->setLights(0, _frameBuffer->numPixels(), _red, _green, _blue);
         } else {
-            mil::System::setLEDs(1, 0, TotalPixels, 0, 0, 0);
+            _frameBuffer->setLights(0, _frameBuffer->numPixels(), 0, 0, 0);
         }
-        mil::System::refreshLEDs(1);
+        _frameBuffer->show();
 	}
 	
-    return 0;
+    // Return the time until the next change so the frame clock
+    // wakes us up right when it's due
+    int32_t remaining = int32_t(_lastFlash + _duration - t);
+    return (remaining > 0) ? remaining : 1;
 }
@@ -15,13 +15,18 @@
 
 #include <stdint.h>
 
+class FrameBuffer;
+
 class Flash
 {
 public:
+    Flash(FrameBuffer* frameBuffer) : _frameBuffer(frameBuffer) { }
+
 	bool init(uint8_t h, uint8_t s, uint8_t v, uint8_t count, uint16_t duration);
 	int32_t loop();
 		
 private:
+    FrameBuffer* _frameBuffer;
     uint8_t _red = 0;
     uint8_t _green = 0;
     uint8_t _blue = 0;
@@ -0,0 +1,203 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "FrameBuffer.h"
+
+#include "System.h"
+
+#include <string.h>
+
+static const char* TAG = "FrameBuffer";
+
+size_t
+FrameBuffer::configure(const Topology& topology)
+{
+    delete [ ] _pixels;
+
+    _topology = topology;
+    _numPixels = topology.numPixels();
+    _pixelsPerPost = topology.pixelsPerPost();
+    _pixels = new uint8_t[_numPixels * 3]();
+    _fadeFrom = nullptr;
+    _dirty.setPixelsPerPost(_pixelsPerPost);
+    clearWindow();
+
+    for (uint8_t i = 0; i < topology.numStrands(); ++i) {
+        const Topology::Strand& strand = topology.strand(i);
+        if (!_output->begin(i + 1, strand.pin, strand.numPosts * _pixelsPerPost)) {
+            mil::System::logE(TAG, "Strand %d on pin %d didn't start", int(i + 1), int(strand.pin));
+        }
+    }
+
+    // Make sure the first show() sends everything
+    _dirty.mark(0, _numPixels);
+    return _numPixels * 3;
+}
+
+void
+FrameBuffer::setLights(uint16_t from, uint16_t count, uint8_t r, uint8_t g, uint8_t b)
+{
+    // Clip to the window
+    uint16_t to = from + count;
+    if (from < _windowFrom) {
+        from = _windowFrom;
+    }
+    if (to > _windowFrom + _windowCount) {
+        to = _windowFrom + _windowCount;
+    }
+    if (to > _numPixels) {
+        to = _numPixels;
+    }
+
+    for (uint16_t i = from; i < to; ++i) {
+        if (setPixel(i, r, g, b)) {
+            _dirty.mark(i, 1);
+        }
+    }
+}
+
+void
+FrameBuffer::setLightsHSV(uint16_t from, const ColorConvert::HSV* hsv, uint16_t count)
+{
+    // Convert a chunk at a time so we can compare against what's there
+    static constexpr uint16_t ChunkSize = 16;
+    uint8_t rgb[ChunkSize * 3];
+
+    while (count > 0) {
+        uint16_t n = (count < ChunkSize) ? count : ChunkSize;
+        ColorConvert::hsvToPixels(hsv, rgb, n);
+        for (uint16_t i = 0; i < n; ++i) {
+            setLights(from + i, 1, rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2]);
+        }
+        from += n;
+        hsv += n;
+        count -= n;
+    }
+}
+
+void
+FrameBuffer::setPost(uint16_t post, uint8_t r, uint8_t g, uint8_t b)
+{
+    // The unrolled versions don't clip, so posts partly outside the window go the slow way
+    uint16_t from = post * _pixelsPerPost;
+    if (from < _windowFrom || from + _pixelsPerPost > _windowFrom + _windowCount || from + _pixelsPerPost > _numPixels) {
+        setLights(from, _pixelsPerPost, r, g, b);
+        return;
+    }
+
+    switch (_pixelsPerPost) {
+        case 8: fillPost<8>(post, r, g, b); break;
+        case 12: fillPost<12>(post, r, g, b); break;
+        case 16: fillPost<16>(post, r, g, b); break;
+        case 24: fillPost<24>(post, r, g, b); break;
+        case 32: fillPost<32>(post, r, g, b); break;
+        default: setLights(from, _pixelsPerPost, r, g, b); break;
+    }
+}
+
+void
+FrameBuffer::clear()
+{
+    memset(_pixels, 0, _numPixels * 3);
+    _dirty.mark(0, _numPixels);
+}
+
+void
+FrameBuffer::fadeFrom(const uint8_t* from, uint8_t amount)
+{
+    _fadeFrom = from;
+    _fadeAmount = amount;
+}
+
+void
+FrameBuffer::endFade()
+{
+    // The lights have the blend, so all of what's drawn has to be sent
+    if (_fadeFrom) {
+        _fadeFrom = nullptr;
+        _dirty.mark(0, _numPixels);
+    }
+}
+
+void
+FrameBuffer::send(uint8_t strand, uint16_t strandStart, uint16_t i, uint16_t count)
+{
+    if (!_fadeFrom) {
+        _output->set(strand, i - strandStart, _pixels + i * 3, count);
+        return;
+    }
+
+    // Blend a chunk at a time
+    static constexpr uint16_t ChunkSize = 32;
+    uint8_t rgb[ChunkSize * 3];
+    uint16_t a = _fadeAmount;
+
+    while (count > 0) {
+        uint16_t n = (count < ChunkSize) ? count : ChunkSize;
+        const uint8_t* to = _pixels + i * 3;
+        const uint8_t* from = _fadeFrom + i * 3;
+        for (uint16_t j = 0; j < n * 3; ++j) {
+            rgb[j] = uint8_t((from[j] * (255 - a) + to[j] * a + 127) / 255);
+        }
+        _output->set(strand, i - strandStart, rgb, n);
+        i += n;
+        count -= n;
+    }
+}
+
+void
+FrameBuffer::show()
+{
+    // Every step of a fade changes every pixel
+    if (_fadeFrom) {
+        _dirty.mark(0, _numPixels);
+    }
+
+    if (!_dirty.dirty()) {
+        _dirty.skipped();
+        return;
+    }
+
+    // Fill each strand with its dirty posts and start its refresh before
+    // going on to the next. A strand still sending from the last show() is
+    // waited for just before it's filled again
+    for (uint8_t s = 0; s < _topology.numStrands(); ++s) {
+        const Topology::Strand& strand = _topology.strand(s);
+        uint16_t strandStart = strand.firstPost * _pixelsPerPost;
+        bool changed = false;
+
+        for (uint16_t post = strand.firstPost; post < strand.firstPost + strand.numPosts; ++post) {
+            if (!_dirty.postDirty(post)) {
+                continue;
+            }
+
+            if (!changed) {
+                _output->wait(s + 1);
+                changed = true;
+            }
+            send(s + 1, strandStart, post * _pixelsPerPost, _pixelsPerPost);
+        }
+
+        // Refreshes always send the whole strand, so nothing is shortened here
+        if (changed) {
+            _output->transmit(s + 1);
+        }
+    }
+
+    _dirty.refreshed(false);
+    _dirty.clear();
+}
+
+std::string
+FrameBuffer::statsString() const
+{
+    return "refreshes=" + std::to_string(stats().refreshes)
+         + " skipped=" + std::to_string(stats().skipped)
+         + " shortened=" + std::to_string(stats().shortened);
+}
@@ -0,0 +1,124 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// FrameBuffer Class
+//
+// RGB copy of what's on the lights. Effects write here and call show().
+// Only pixels which actually changed are marked dirty, only dirty posts
+// are passed on to the LedOutput and strands are refreshed only when
+// something on them changed. Pixels are numbered across all strands in
+// post order. show() sends each to its own strand, starting each strand's
+// refresh before filling the next so they can go out together.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "ColorConvert.h"
+#include "DirtyTracker.h"
+#include "LedOutput.h"
+#include "Topology.h"
+
+class FrameBuffer
+{
+public:
+    // Has no pixels until configure()
+    FrameBuffer(LedOutput* output = LedOutput::platformDefault()) : _output(output), _dirty(1) { }
+    FrameBuffer(const Topology& topology, LedOutput* output = LedOutput::platformDefault())
+        : FrameBuffer(output)
+    {
+        configure(topology);
+    }
+    ~FrameBuffer() { delete [ ] _pixels; }
+
+    // Size for topology and start its strands. Returns the number of bytes allocated
+    size_t configure(const Topology&);
+
+    const Topology& topology() const { return _topology; }
+    uint16_t numPixels() const { return _numPixels; }
+    uint16_t pixelsPerPost() const { return _pixelsPerPost; }
+
+    // Writes outside the window are ignored. This lets an effect which
+    // renders every post run on just some of them
+    void setWindow(uint16_t from, uint16_t count) { _windowFrom = from; _windowCount = count; }
+    void clearWindow() { setWindow(0, _numPixels); }
+
+    void setLights(uint16_t from, uint16_t count, uint8_t r, uint8_t g, uint8_t b);
+    void setLightsHSV(uint16_t from, const ColorConvert::HSV* hsv, uint16_t count);
+
+    // Set every pixel of a post. Common post sizes have their own unrolled loop
+    void setPost(uint16_t post, uint8_t r, uint8_t g, uint8_t b);
+
+    // Turn every pixel off without showing it, so the next effect starts
+    // from black rather than on top of what's there
+    void clear();
+
+    // Crossfade to what effects draw from another frame of numPixels RGB
+    // pixels. amount is how much of the drawn frame is shown, 0 to 255.
+    // While fading show() sends every post. from must stay valid until
+    // endFade(), which goes back to sending just what's drawn
+    void fadeFrom(const uint8_t* from, uint8_t amount);
+    void endFade();
+    bool fading() const { return _fadeFrom != nullptr; }
+
+    // What effects have drawn, which isn't what's on the lights while fading
+    const uint8_t* pixels() const { return _pixels; }
+
+    // For a PixelStream to receive pixels straight into. Call streamed()
+    // with the pixels written so they're sent at the next show()
+    uint8_t* streamPixels() { return _pixels; }
+    void streamed(uint16_t from, uint16_t count) { _dirty.mark(from, count); }
+
+    // Send changed posts to the lights and refresh the strands they're on
+    void show();
+
+    const DirtyTracker::Stats& stats() const { return _dirty.stats(); }
+    std::string statsString() const;
+
+private:
+    bool setPixel(uint16_t i, uint8_t r, uint8_t g, uint8_t b)
+    {
+        uint8_t* p = _pixels + i * 3;
+        if (p[0] == r && p[1] == g && p[2] == b) {
+            return false;
+        }
+        p[0] = r;
+        p[1] = g;
+        p[2] = b;
+        return true;
+    }
+
+    // Send count pixels starting at i to a strand, blended if fading
+    void send(uint8_t strand, uint16_t strandStart, uint16_t i, uint16_t count);
+
+    template<uint16_t N>
+    void fillPost(uint16_t post, uint8_t r, uint8_t g, uint8_t b)
+    {
+        uint16_t from = post * N;
+        bool changed = false;
+        for (uint16_t i = 0; i < N; ++i) {
+            changed |= setPixel(from + i, r, g, b);
+        }
+        if (changed) {
+            _dirty.mark(from, N);
+        }
+    }
+
+    LedOutput* _output;
+    Topology _topology;
+    uint16_t _numPixels = 0;
+    uint16_t _pixelsPerPost = 1;
+    uint8_t* _pixels = nullptr;
+    uint16_t _windowFrom = 0;
+    uint16_t _windowCount = 0;
+    const uint8_t* _fadeFrom = nullptr;
+    uint8_t _fadeAmount = 0;
+    DirtyTracker _dirty;
+};
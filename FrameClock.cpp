@@ -0,0 +1,71 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "FrameClock.h"
+
+#include "System.h"
+
+// Longest single sleep, so a wake() is noticed promptly
+static constexpr int32_t WakeCheckInterval = 5; // ms
+
+void
+FrameClock::reset()
+{
+    _deadline = mil::System::millis();
+}
+
+void
+FrameClock::wait(int32_t delayInMs)
+{
+    _deadline += delayInMs;
+    _stats.frames++;
+
+    // If the frame took longer than its delay we can't make it up. Count
+    // it and restart timing from now rather than trying to catch up.
+    if (int32_t(mil::System::millis() - _deadline) > 0) {
+        _stats.overruns++;
+        _deadline = mil::System::millis();
+    }
+
+    while (!_wake) {
+        int32_t remaining = int32_t(_deadline - mil::System::millis());
+        if (remaining <= 0) {
+            break;
+        }
+        mil::System::delay((remaining < WakeCheckInterval) ? remaining : WakeCheckInterval);
+    }
+
+    uint32_t now = mil::System::millis();
+
+    if (_wake.exchange(false)) {
+        // Woken early, the next frame is timed from here
+        _stats.wakes++;
+        _deadline = now;
+        return;
+    }
+
+    int32_t jitter = int32_t(now - _deadline);
+    _stats.lastJitter = jitter;
+    _stats.totalJitter += jitter;
+    if (jitter > _stats.maxJitter) {
+        _stats.maxJitter = jitter;
+    }
+}
+
+std::string
+FrameClock::statsString() const
+{
+    uint32_t avgJitter = _stats.frames ? (_stats.totalJitter / _stats.frames) : 0;
+    return "frames=" + std::to_string(_stats.frames)
+         + " overruns=" + std::to_string(_stats.overruns)
+         + " wakes=" + std::to_string(_stats.wakes)
+         + " jitter(last/avg/max)=" + std::to_string(_stats.lastJitter)
+         + "/" + std::to_string(avgJitter)
+         + "/" + std::to_string(_stats.maxJitter) + "ms";
+}
@@ -0,0 +1,55 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// FrameClock Class
+//
+// Sleeps until absolute frame deadlines rather than for a fixed delay
+// after each frame, so the time spent rendering a frame is subtracted
+// from the wait. wake() can be called (e.g., when an HTTP command
+// arrives) to end the current wait early. Per-frame jitter (how late
+// we woke up) and overruns (frames which took longer than their delay)
+// are recorded.
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+class FrameClock
+{
+public:
+    struct Stats
+    {
+        uint32_t frames = 0;
+        uint32_t overruns = 0;
+        uint32_t wakes = 0;
+        int32_t lastJitter = 0; // ms
+        int32_t maxJitter = 0; // ms
+        uint32_t totalJitter = 0; // ms, for computing average
+    };
+
+    // Start timing from now
+    void reset();
+
+    // Wait until delayInMs after the previous deadline
+    void wait(int32_t delayInMs);
+
+    // End the current (or next) wait early
+    void wake() { _wake = true; }
+
+    const Stats& stats() const { return _stats; }
+    void clearStats() { _stats = Stats(); }
+    std::string statsString() const;
+
+private:
+    uint32_t _deadline = 0;
+    std::atomic<bool> _wake { false };
+    Stats _stats;
+};
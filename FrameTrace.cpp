@@ -0,0 +1,201 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "FrameTrace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool
+FrameTrace::create(uint16_t numPixels, uint32_t capacity, const char* path)
+{
+    close();
+
+    if (numPixels == 0 || capacity == 0) {
+        return false;
+    }
+
+    // Keep records 8 byte aligned
+    uint32_t recordSize = (sizeof(Record) + numPixels * 3 + 7) & ~uint32_t(7);
+    _size = sizeof(Header) + size_t(capacity) * recordSize;
+
+#ifdef HAVE_MMAP
+    if (path) {
+        int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+
+        if (ftruncate(fd, off_t(_size)) == 0) {
+            void* map = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (map != MAP_FAILED) {
+                _data = reinterpret_cast<uint8_t*>(map);
+                _mapped = true;
+            }
+        }
+
+        // The mapping stays valid after the file is closed
+        ::close(fd);
+        if (!_mapped) {
+            return false;
+        }
+        path = nullptr;
+    }
+#endif
+
+    if (!_data) {
+        _data = reinterpret_cast<uint8_t*>(calloc(1, _size));
+        if (!_data) {
+            return false;
+        }
+        if (path) {
+            _path = strdup(path);
+        }
+    }
+
+    _header = reinterpret_cast<Header*>(_data);
+    _header->magic = Magic;
+    _header->version = Version;
+    _header->numPixels = numPixels;
+    _header->capacity = capacity;
+    _header->recordSize = recordSize;
+    _header->frames = 0;
+    _writable = true;
+    return true;
+}
+
+bool
+FrameTrace::open(const char* path)
+{
+    close();
+
+#ifdef HAVE_MMAP
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Header)) {
+        void* map = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            _data = reinterpret_cast<uint8_t*>(map);
+            _size = size_t(st.st_size);
+            _mapped = true;
+        }
+    }
+    ::close(fd);
+#else
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size >= long(sizeof(Header))) {
+        _data = reinterpret_cast<uint8_t*>(malloc(size_t(size)));
+        if (_data && fread(_data, 1, size_t(size), f) == size_t(size)) {
+            _size = size_t(size);
+        } else {
+            free(_data);
+            _data = nullptr;
+        }
+    }
+    fclose(f);
+#endif
+
+    if (!_data) {
+        return false;
+    }
+
+    // Make sure it's a trace and all of it is there
+    const Header* header = reinterpret_cast<const Header*>(_data);
+    if (header->magic != Magic || header->version != Version || header->capacity == 0 ||
+            header->recordSize < sizeof(Record) + header->numPixels * 3 ||
+            _size < sizeof(Header) + size_t(header->capacity) * header->recordSize) {
+        close();
+        return false;
+    }
+
+    _header = reinterpret_cast<Header*>(_data);
+    return true;
+}
+
+void
+FrameTrace::close()
+{
+    if (_path && _data) {
+        FILE* f = fopen(_path, "wb");
+        if (f) {
+            fwrite(_data, 1, _size, f);
+            fclose(f);
+        }
+    }
+
+#ifdef HAVE_MMAP
+    if (_mapped) {
+        munmap(_data, _size);
+        _data = nullptr;
+    }
+#endif
+    free(_data);
+    free(_path);
+
+    _data = nullptr;
+    _size = 0;
+    _header = nullptr;
+    _mapped = false;
+    _writable = false;
+    _path = nullptr;
+}
+
+void
+FrameTrace::append(uint64_t time, const uint8_t* rgb, uint16_t first, uint16_t count)
+{
+    if (!_writable) {
+        return;
+    }
+
+    if (first > _header->numPixels) {
+        first = _header->numPixels;
+    }
+    if (count > _header->numPixels - first) {
+        count = _header->numPixels - first;
+    }
+
+    Record* record = slot(_header->frames);
+    record->time = time;
+    record->first = first;
+    record->count = count;
+    record->reserved = 0;
+    memcpy(record + 1, rgb + first * 3, count * 3);
+
+    // Count the frame last, so a reader never sees a partly written one as the newest
+    _header->frames++;
+}
+
+const FrameTrace::Record*
+FrameTrace::record(uint32_t i) const
+{
+    if (i >= available()) {
+        return nullptr;
+    }
+    return slot(frames() - available() + i);
+}
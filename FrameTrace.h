@@ -0,0 +1,95 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// FrameTrace Class
+//
+// Records the frames sent to the lights on a host build, in place of
+// printing every pixel. Frames go into a fixed size ring, so once it's
+// full the oldest are overwritten. Each record has a timestamp in us, the
+// range of pixels which changed and the RGB of just those pixels, so a
+// frame which changes a few pixels costs a few pixels. Given a path
+// (and where the platform has mmap) the ring is a file mapped into memory,
+// so appending is just a copy and the trace is still there after the
+// process exits. Elsewhere the ring is in RAM and written out on close().
+//
+// The file is a Header followed by capacity records of recordSize bytes,
+// all little endian. Record i of frames is at slot i % capacity. A slot
+// has room for every pixel, since any frame can change them all.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class FrameTrace
+{
+public:
+    static constexpr uint32_t Magic = 0x54434c50; // "PLCT"
+    static constexpr uint16_t Version = 2;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t numPixels;
+        uint32_t capacity;
+        uint32_t recordSize;
+        uint64_t frames; // Number ever appended
+    };
+
+    // Followed by count * 3 bytes of RGB, for pixels first to first + count
+    struct Record
+    {
+        uint64_t time;
+        uint16_t first;
+        uint16_t count;
+        uint32_t reserved;
+    };
+
+    FrameTrace() { }
+    ~FrameTrace() { close(); }
+
+    FrameTrace(const FrameTrace&) = delete;
+    FrameTrace& operator=(const FrameTrace&) = delete;
+
+    // Start a new trace. Returns false if the file can't be made
+    bool create(uint16_t numPixels, uint32_t capacity, const char* path = nullptr);
+
+    // Open an existing trace for reading
+    bool open(const char* path);
+    void close();
+
+    bool valid() const { return _header != nullptr; }
+    uint16_t numPixels() const { return _header ? _header->numPixels : 0; }
+    uint32_t capacity() const { return _header ? _header->capacity : 0; }
+    uint64_t frames() const { return _header ? _header->frames : 0; }
+
+    // Number of frames still in the ring
+    uint32_t available() const { return (frames() < capacity()) ? uint32_t(frames()) : capacity(); }
+
+    // rgb is the whole frame. Only pixels first to first + count are kept
+    void append(uint64_t time, const uint8_t* rgb, uint16_t first, uint16_t count);
+
+    // i is 0 for the oldest frame still in the ring
+    const Record* record(uint32_t i) const;
+    static const uint8_t* pixels(const Record* record) { return reinterpret_cast<const uint8_t*>(record + 1); }
+
+private:
+    Record* slot(uint64_t frame) const
+    {
+        return reinterpret_cast<Record*>(_data + sizeof(Header) + size_t(frame % _header->capacity) * _header->recordSize);
+    }
+
+    uint8_t* _data = nullptr;
+    size_t _size = 0;
+    Header* _header = nullptr;
+    bool _mapped = false;
+    bool _writable = false;
+    char* _path = nullptr; // Where to write an unmapped trace on close()
+};
@@ -11,53 +11,130 @@
 
 #include "mil.h"
 
-#include "lua.hpp"
+#if !defined ARDUINO
+#include "System.h"
+#endif
 
 // These must match values in Clover code
 static constexpr int SetLight = 1;
 static constexpr int SetLights = 2;
 static constexpr int ShowLights = 3;
+static constexpr int SetFrame = 4;
+
+const InterpretedEffect::UserFunction InterpretedEffect::_userFunctions[ ] =
+{
+    nullptr,
+    &InterpretedEffect::setLight,       // SetLight
+    &InterpretedEffect::setLights,      // SetLights
+    &InterpretedEffect::showLights,     // ShowLights
+    &InterpretedEffect::setFrame,       // SetFrame
+};
+
+const uint16_t InterpretedEffect::_numUserFunctions = sizeof(_userFunctions) / sizeof(_userFunctions[0]);
+
+static uint32_t
+currentMillis()
+{
+#if defined ARDUINO
+    return millis();
+#else
+    return mil::System::millis();
+#endif
+}
+
+uint8_t
+InterpretedEffect::codeByte(uint32_t addr, void* data)
+{
+    InterpretedEffect* effect = reinterpret_cast<InterpretedEffect*>(data);
+    effect->_fetches++;
+    return effect->_getCodeByte(addr, effect->_codeData);
+}
 
 void
 InterpretedEffect::userCall(uint16_t id, clvr::InterpreterBase* interp, void* data)
 {
     InterpretedEffect* effect = reinterpret_cast<InterpretedEffect*>(data);
-
-    if (id == ShowLights) {
-        effect->_pixels->show();
-        return;
-    }
-    
-    clvr::AddrNativeType addr = 0;
-    uint8_t i = 0;
-    uint8_t from = 0;
-    uint8_t count = 0;
     
-    if (id == SetLight) {
-        // First arg is byte index of light to set. Next is a ptr to a struct of
-        // h, s, v byte values (0-255)
-        i = interp->memMgr()->getArg(2, clvr::VarArgSize);
-        addr = interp->memMgr()->getArg(clvr::VarArgSize + 2, clvr::AddrSize);
-    } else {
-        // First arg is byte index of the first light to set. Next is the number
-        // of consecutive lights to set. Next is a ptr to a struct of
-        // h, s, v byte values (0-255)
-        from = interp->memMgr()->getArg(2, clvr::VarArgSize);
-        count = interp->memMgr()->getArg(clvr::VarArgSize + 2, clvr::VarArgSize);
-        addr = interp->memMgr()->getArg(clvr::VarArgSize * 2 + 2, clvr::AddrSize);
+    if (id < _numUserFunctions && _userFunctions[id]) {
+        (effect->*_userFunctions[id])(interp);
     }
+}
+
+void
+InterpretedEffect::setLight(clvr::InterpreterBase* interp)
+{
+    // First arg is byte index of light to set. Next is a ptr to a struct of
+    // h, s, v byte values (0-255)
+    uint8_t i = interp->memMgr()->getArg(2, clvr::VarArgSize);
+    clvr::AddrNativeType addr = interp->memMgr()->getArg(clvr::VarArgSize + 2, clvr::AddrSize);
     
     uint8_t h = interp->memMgr()->getAbs(addr, 1);
     uint8_t s = interp->memMgr()->getAbs(addr + 1, 1);
     uint8_t v = interp->memMgr()->getAbs(addr + 2, 1);
+    fill(i, 1, h, s, v);
+}
 
-    if (id == SetLight) {
-        effect->_pixels->setLight(i, effect->_pixels->color(h, s, v));
-    } else {
-        effect->_pixels->setLights(from, count, effect->_pixels->color(h, s, v));
+void
+InterpretedEffect::setLights(clvr::InterpreterBase* interp)
+{
+    // First arg is byte index of the first light to set. Next is the number
+    // of consecutive lights to set. Next is a ptr to a struct of
+    // h, s, v byte values (0-255)
+    uint8_t from = interp->memMgr()->getArg(2, clvr::VarArgSize);
+    uint8_t count = interp->memMgr()->getArg(clvr::VarArgSize + 2, clvr::VarArgSize);
+    clvr::AddrNativeType addr = interp->memMgr()->getArg(clvr::VarArgSize * 2 + 2, clvr::AddrSize);
+    
+    uint8_t h = interp->memMgr()->getAbs(addr, 1);
+    uint8_t s = interp->memMgr()->getAbs(addr + 1, 1);
+    uint8_t v = interp->memMgr()->getAbs(addr + 2, 1);
+    fill(from, count, h, s, v);
+}
+
+void
+InterpretedEffect::showLights(clvr::InterpreterBase*)
+{
+    _pixels->show();
+}
+
+void
+InterpretedEffect::setFrame(clvr::InterpreterBase* interp)
+{
+    // First arg is byte index of the first light to set. Next is the number
+    // of lights to set. Next is a ptr to an array of count structs of
+    // h, s, v byte values (0-255), one for each light
+    uint16_t from = interp->memMgr()->getArg(2, clvr::VarArgSize);
+    uint8_t count = interp->memMgr()->getArg(clvr::VarArgSize + 2, clvr::VarArgSize);
+    clvr::AddrNativeType addr = interp->memMgr()->getArg(clvr::VarArgSize * 2 + 2, clvr::AddrSize);
+    
+    // Convert a few at a time to keep the stack small on the Nano
+    static constexpr uint8_t ChunkSize = 8;
+    ColorConvert::HSV hsv[ChunkSize];
+    
+    while (count > 0) {
+        uint8_t n = (count < ChunkSize) ? count : ChunkSize;
+        for (uint8_t i = 0; i < n; ++i, addr += 3) {
+            hsv[i] = { uint8_t(interp->memMgr()->getAbs(addr, 1)),
+                       uint8_t(interp->memMgr()->getAbs(addr + 1, 1)),
+                       uint8_t(interp->memMgr()->getAbs(addr + 2, 1)) };
+        }
+        _pixels->setLightsHSV(from, hsv, n);
+        from += n;
+        count -= n;
     }
 }
 
+void
+InterpretedEffect::fill(uint16_t from, uint16_t count, uint8_t h, uint8_t s, uint8_t v)
+{
+#if defined ARDUINO
+    _pixels->setLights(from, count, _pixels->color(h, s, v));
+#else
+    uint8_t r, g, b;
+    ColorConvert::hsvToRGB(h, s, v, r, g, b);
+    _pixels->setLights(from, count, r, g, b);
+#endif
+}
+
 bool
 InterpretedEffect::init(uint8_t cmd, const uint8_t* buf, uint32_t size)
 {
@@ -71,6 +148,7 @@ InterpretedEffect::init(uint8_t cmd, const uint8_t* buf, uint32_t size)
     _interp.addUserFunction(SetLight, userCall, this);
     _interp.addUserFunction(SetLights, userCall, this);
     _interp.addUserFunction(ShowLights, userCall, this);
+    _interp.addUserFunction(SetFrame, userCall, this);
 
     for (int i = size - 1; i >= 0; --i) {
         _interp.addArg(buf[i], clvr::Type::UInt8);
@@ -95,7 +173,46 @@ InterpretedEffect::init(uint8_t cmd, const uint8_t* buf, uint32_t size)
 int32_t
 InterpretedEffect::loop()
 {
-    uint32_t result = 0; //_interp.interp(MyInterpreter::ExecMode::Start);
+    uint32_t startTime = currentMillis();
+    _fetches = 0;
+    
+    int32_t result = _interp.interp(MyInterpreter::ExecMode::Start);
     _pixels->show();
-    return (_interp.error() != clvr::Memory::Error::None) ? -1 : result;
+    
+    if (_interp.error() != clvr::Memory::Error::None) {
+        return -1;
+    }
+    
+    uint32_t elapsed = currentMillis() - startTime;
+    
+    _stats.frames++;
+    _stats.lastFetches = _fetches;
+    if (_fetches > _stats.maxFetches) {
+        _stats.maxFetches = _fetches;
+    }
+    if (elapsed > _stats.maxTime) {
+        _stats.maxTime = elapsed;
+    }
+    
+    if (_fetches > FetchBudget || elapsed > TimeBudget) {
+        // Give everything else at least as long as we took
+        _stats.overruns++;
+        if (result >= 0 && result < int32_t(elapsed)) {
+            result = elapsed;
+        }
+    }
+    
+    return result;
+}
+
+#if !defined ARDUINO
+std::string
+InterpretedEffect::statsString() const
+{
+    return "frames=" + std::to_string(_stats.frames)
+         + " overruns=" + std::to_string(_stats.overruns)
+         + " fetches=" + std::to_string(_stats.lastFetches)
+         + " maxFetches=" + std::to_string(_stats.maxFetches)
+         + " maxTime=" + std::to_string(_stats.maxTime) + "ms";
 }
+#endif
@@ -9,12 +9,31 @@
 
 // InterpretedEffect Class
 //
-// This class runs the Interpreter
+// This class runs the Interpreter. Each loop() runs the effect's main
+// function once, which does one frame and returns the delay until the
+// next. Effect state lives in interpreter memory between calls, so each
+// frame picks up where the last one left off.
+//
+// Code bytes are counted as they're fetched, as a measure of how many
+// instructions a frame took. A frame over its fetch or time budget is
+// recorded as an overrun and the next frame is put off at least as long
+// as this one took, so a heavy effect gets no more than half the time and
+// serial and HTTP handling still get to run.
+//
+// On the Arduino it draws on a NeoPixel strip. Elsewhere it draws into a
+// FrameBuffer like the other effects, and code usually comes from a
+// CodeProvider (see CodeProvider.h).
 
 #pragma once
 
 #include "Interpreter.h"
+
+#if defined ARDUINO
 #include "NeoPixel.h"
+#else
+#include "FrameBuffer.h"
+#include <string>
+#endif
 
 static constexpr uint32_t StackSize = 1024;
 
@@ -27,9 +46,26 @@ class MyInterpreter : public clvr::Interpreter<StackSize>
 class InterpretedEffect
 {
 public:
-	InterpretedEffect(mil::NeoPixel* pixels, clvr::GetCodeByteCB cb, void* data)
-        : _interp(cb, data)
+#if defined ARDUINO
+    using Pixels = mil::NeoPixel;
+#else
+    using Pixels = FrameBuffer;
+#endif
+
+    struct Stats
+    {
+        uint32_t frames = 0;
+        uint32_t overruns = 0;
+        uint32_t lastFetches = 0;
+        uint32_t maxFetches = 0;
+        uint32_t maxTime = 0; // ms
+    };
+
+	InterpretedEffect(Pixels* pixels, clvr::GetCodeByteCB cb, void* data)
+        : _interp(codeByte, this)
         , _pixels(pixels)
+        , _getCodeByte(cb)
+        , _codeData(data)
     {
     }
 	
@@ -41,8 +77,34 @@ public:
 
     uint8_t* stackBase() { return &(_interp.memMgr()->stack().getAbs(0)); }
 
+    const Stats& stats() const { return _stats; }
+#if !defined ARDUINO
+    std::string statsString() const;
+#endif
+
 private:
+    static constexpr uint32_t FetchBudget = 20000; // Code bytes per frame
+    static constexpr uint32_t TimeBudget = 10; // ms per frame
+
+    static uint8_t codeByte(uint32_t addr, void* data);
     static void userCall(uint16_t id, clvr::InterpreterBase*, void* data);
+    
+    // Handlers for each user function, indexed by id
+    using UserFunction = void (InterpretedEffect::*)(clvr::InterpreterBase*);
+    static const UserFunction _userFunctions[ ];
+    static const uint16_t _numUserFunctions;
+    
+    void setLight(clvr::InterpreterBase*);
+    void setLights(clvr::InterpreterBase*);
+    void showLights(clvr::InterpreterBase*);
+    void setFrame(clvr::InterpreterBase*);
+    
+    void fill(uint16_t from, uint16_t count, uint8_t h, uint8_t s, uint8_t v);
+    
 	MyInterpreter _interp;
-    mil::NeoPixel* _pixels;
+    Pixels* _pixels;
+    clvr::GetCodeByteCB _getCodeByte;
+    void* _codeData;
+    uint32_t _fetches = 0;
+    Stats _stats;
 };
@@ -0,0 +1,133 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "LedAnimator.h"
+
+#include "NativeEffect.h"
+
+void
+LedAnimator::release()
+{
+    delete [ ] _cur;
+    delete [ ] _inc;
+    delete [ ] _min;
+    delete [ ] _max;
+    delete [ ] _hitMin;
+    delete [ ] _frame;
+}
+
+size_t
+LedAnimator::configure(uint16_t numPixels)
+{
+    release();
+
+    _numPixels = numPixels;
+    _count = 0;
+    _cur = new int16_t[numPixels];
+    _inc = new int16_t[numPixels];
+    _min = new int16_t[numPixels];
+    _max = new int16_t[numPixels];
+    _hitMin = new bool[numPixels];
+    _frame = new ColorConvert::HSV[numPixels];
+    return numPixels * (sizeof(int16_t) * 4 + sizeof(bool) + sizeof(ColorConvert::HSV));
+}
+
+bool
+LedAnimator::setup(uint16_t count, Channel channel)
+{
+    if (count == 0 || count > _numPixels) {
+        return false;
+    }
+
+    _count = count;
+    _channel = channel;
+    _respawn = false;
+
+    for (uint16_t i = 0; i < _count; ++i) {
+        set(i, 0, 0, 0, 0);
+    }
+    return true;
+}
+
+void
+LedAnimator::set(uint16_t i, int16_t cur, int16_t inc, int16_t min, int16_t max)
+{
+    if (i >= _count) {
+        return;
+    }
+
+    _cur[i] = cur;
+    _inc[i] = inc;
+    _min[i] = min;
+    _max[i] = max;
+}
+
+void
+LedAnimator::setRespawn(uint8_t cur, uint8_t incMin, uint8_t incMax, uint8_t maxMin, uint8_t maxMax)
+{
+    _respawn = true;
+    _respawnCur = cur;
+    _respawnIncMin = incMin;
+    _respawnIncMax = incMax;
+    _respawnMaxMin = maxMin;
+    _respawnMaxMax = maxMax;
+}
+
+void
+LedAnimator::step()
+{
+    // Same as NativeEffect::animate, written as selects. The sum is done
+    // in 32 bits since cur + inc can overflow an int16_t near max
+    for (uint16_t i = 0; i < _count; ++i) {
+        int32_t inc = _inc[i];
+        int32_t next = int32_t(_cur[i]) + inc;
+        bool hitMax = inc > 0 && next >= _max[i];
+        bool hitMin = inc <= 0 && next <= _min[i];
+
+        _cur[i] = hitMax ? _max[i] : (hitMin ? _min[i] : int16_t(next));
+        _inc[i] = (hitMax || hitMin) ? int16_t(-inc) : int16_t(inc);
+        _hitMin[i] = hitMin;
+    }
+
+    if (!_respawn) {
+        return;
+    }
+
+    // We are done with the throb. Start again at the respawn value with
+    // a new random inc (how fast it pulses) and max (how bright it gets)
+    for (uint16_t i = 0; i < _count; ++i) {
+        if (_hitMin[i]) {
+            _cur[i] = int16_t(_respawnCur) * 128;
+            _min[i] = _cur[i];
+            _inc[i] = NativeEffect::irand(_respawnIncMin, _respawnIncMax) * 128;
+            _max[i] = NativeEffect::irand(_respawnMaxMin, _respawnMaxMax) * 128;
+        }
+    }
+}
+
+void
+LedAnimator::render(FrameBuffer* frameBuffer, uint8_t h, uint8_t s, uint8_t v)
+{
+    if (_count == 0) {
+        return;
+    }
+
+    uint16_t pixelsPerEntry = _numPixels / _count;
+    ColorConvert::HSV* p = _frame;
+
+    for (uint16_t i = 0; i < _count; ++i) {
+        uint8_t value = uint8_t(_cur[i] / 128);
+        ColorConvert::HSV hsv = (_channel == Channel::Hue) ? ColorConvert::HSV { value, s, v } : ColorConvert::HSV { h, s, value };
+        for (uint16_t j = 0; j < pixelsPerEntry; ++j) {
+            *p++ = hsv;
+        }
+    }
+
+    frameBuffer->setLightsHSV(0, _frame, pixelsPerEntry * _count);
+}
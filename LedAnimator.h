@@ -0,0 +1,80 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// LedAnimator Class
+//
+// Native version of the LedEntry animation in PostLightEffects.clvr and
+// f.lua, for scripts to call rather than animating each pixel in Lua.
+// Entries are kept as separate cur, inc, min and max arrays (same fixed
+// point format as LedEntry) so step() is one tight loop over all of them
+// with no branches the compiler can't turn into selects.
+//
+// Each entry animates either the hue or the value of its pixels. With
+// fewer entries than pixels each entry covers an equal share of them
+// (e.g., one entry per post). An entry which reaches its min can be
+// respawned with a new random inc and max, which is how flicker works.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "ColorConvert.h"
+#include "FrameBuffer.h"
+
+class LedAnimator
+{
+public:
+    LedAnimator() { }
+    ~LedAnimator() { release(); }
+
+    // Make room for up to one entry per pixel. Returns the number of bytes allocated
+    size_t configure(uint16_t numPixels);
+
+    enum class Channel { Hue, Value };
+
+    // Returns false if count is 0 or more than the number of pixels. All
+    // entries start at 0 with no respawn
+    bool setup(uint16_t count, Channel channel);
+
+    // Values are fixed point, 1/128 units
+    void set(uint16_t i, int16_t cur, int16_t inc, int16_t min, int16_t max);
+
+    // When an entry reaches its min, restart it at cur with an inc from
+    // incMin to incMax and a max from maxMin to maxMax. Values are 0-255,
+    // not fixed point, like the random values in f.lua
+    void setRespawn(uint8_t cur, uint8_t incMin, uint8_t incMax, uint8_t maxMin, uint8_t maxMax);
+
+    // Move every entry one step, bouncing at min and max
+    void step();
+
+    // Write all pixels. h, s and v are used for the channels not being animated
+    void render(FrameBuffer*, uint8_t h, uint8_t s, uint8_t v);
+
+private:
+    void release();
+
+    uint16_t _numPixels = 0;
+    uint16_t _count = 0;
+    Channel _channel = Channel::Value;
+
+    int16_t* _cur = nullptr;
+    int16_t* _inc = nullptr;
+    int16_t* _min = nullptr;
+    int16_t* _max = nullptr;
+    bool* _hitMin = nullptr;
+
+    bool _respawn = false;
+    uint8_t _respawnCur = 0;
+    uint8_t _respawnIncMin = 0;
+    uint8_t _respawnIncMax = 0;
+    uint8_t _respawnMaxMin = 0;
+    uint8_t _respawnMaxMax = 0;
+
+    ColorConvert::HSV* _frame = nullptr;
+};
@@ -0,0 +1,132 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "LedOutput.h"
+
+#include "System.h"
+#include "Topology.h"
+
+#include <string.h>
+
+#if defined ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#if defined CONFIG_PLC_RMT_STRANDS
+#include "led_strip.h"
+
+static const char* TAG = "LedOutput";
+
+// Each strand has its own RMT channel (the ESP32-C3 has 2 for TX, others
+// more) and led_strip keeps the pixels in wire order, so set() is the
+// encoding and refreshes run in the background
+class RmtLedOutput : public LedOutput
+{
+public:
+    virtual bool begin(uint8_t strand, uint8_t pin, uint16_t count) override
+    {
+        if (strand < 1 || strand > Topology::MaxStrands) {
+            return false;
+        }
+
+        led_strip_handle_t& strip = _strips[strand - 1];
+        if (strip) {
+            led_strip_del(strip);
+            strip = nullptr;
+        }
+
+        led_strip_config_t config = { };
+        config.strip_gpio_num = pin;
+        config.max_leds = count;
+        config.led_model = LED_MODEL_WS2812;
+        config.color_component_format = LED_STRIP_COLOR_COMPONENT_FMT_GRB;
+
+        led_strip_rmt_config_t rmtConfig = { };
+        rmtConfig.clk_src = RMT_CLK_SRC_DEFAULT;
+        rmtConfig.resolution_hz = 10 * 1000 * 1000;
+
+        if (led_strip_new_rmt_device(&config, &rmtConfig, &strip) != ESP_OK) {
+            mil::System::logE(TAG, "Can't start strand %d on pin %d", int(strand), int(pin));
+            strip = nullptr;
+            return false;
+        }
+        led_strip_clear(strip);
+        return true;
+    }
+
+    virtual void set(uint8_t strand, uint16_t from, const uint8_t* rgb, uint16_t count) override
+    {
+        led_strip_handle_t strip = _strips[strand - 1];
+        if (strip) {
+            for (uint16_t i = 0; i < count; ++i, rgb += 3) {
+                led_strip_set_pixel(strip, from + i, rgb[0], rgb[1], rgb[2]);
+            }
+        }
+    }
+
+    virtual void transmit(uint8_t strand) override
+    {
+        led_strip_handle_t strip = _strips[strand - 1];
+        if (strip) {
+            led_strip_refresh_async(strip);
+        }
+    }
+
+    virtual void wait(uint8_t strand) override
+    {
+        led_strip_handle_t strip = _strips[strand - 1];
+        if (strip) {
+            led_strip_refresh_wait(strip);
+        }
+    }
+
+private:
+    led_strip_handle_t _strips[Topology::MaxStrands] = { };
+};
+#endif
+
+LedOutput*
+LedOutput::platformDefault()
+{
+#if defined CONFIG_PLC_RMT_STRANDS
+    static RmtLedOutput output;
+#else
+    static SystemLedOutput output;
+#endif
+    return &output;
+}
+
+bool
+SystemLedOutput::begin(uint8_t strand, uint8_t pin, uint16_t count)
+{
+    mil::System::initLED(strand, pin, count);
+    return true;
+}
+
+void
+SystemLedOutput::set(uint8_t strand, uint16_t from, const uint8_t* rgb, uint16_t count)
+{
+    // Combine runs of the same color
+    uint16_t i = 0;
+    while (i < count) {
+        const uint8_t* p = rgb + i * 3;
+        uint16_t run = 1;
+        while (i + run < count && memcmp(p, p + run * 3, 3) == 0) {
+            ++run;
+        }
+        mil::System::setLEDs(strand, from + i, run, p[0], p[1], p[2]);
+        i += run;
+    }
+}
+
+void
+SystemLedOutput::transmit(uint8_t strand)
+{
+    mil::System::refreshLEDs(strand);
+}
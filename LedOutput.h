@@ -0,0 +1,56 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// LedOutput Classes
+//
+// How FrameBuffer gets pixels onto the strands. Each strand has its own
+// buffer of pixels in wire order. FrameBuffer::show() fills the buffer of
+// each changed strand and starts it sending, then goes on to the next.
+// Where the driver can send in the background (transmit() returns before
+// it's done), strands go out at the same time and filling strand k + 1
+// overlaps sending strand k. Before a strand's buffer is filled again,
+// wait() makes sure it's done sending.
+//
+// SystemLedOutput goes through mil::System and sends one strand at a
+// time. On ESP with CONFIG_PLC_RMT_STRANDS, RmtLedOutput drives each
+// strand on its own RMT channel with led_strip, in the background.
+// platformDefault() is the one to use.
+
+#pragma once
+
+#include <stdint.h>
+
+class LedOutput
+{
+public:
+    virtual ~LedOutput() { }
+
+    // Strands are numbered from 1. Returns false if the strand can't be started
+    virtual bool begin(uint8_t strand, uint8_t pin, uint16_t count) = 0;
+
+    // Put count RGB pixels into the strand's buffer, starting at from
+    virtual void set(uint8_t strand, uint16_t from, const uint8_t* rgb, uint16_t count) = 0;
+
+    // Start sending the strand's buffer. Can return before it's done
+    virtual void transmit(uint8_t strand) = 0;
+
+    // Returns once the strand is done sending
+    virtual void wait(uint8_t strand) = 0;
+
+    static LedOutput* platformDefault();
+};
+
+class SystemLedOutput : public LedOutput
+{
+public:
+    virtual bool begin(uint8_t strand, uint8_t pin, uint16_t count) override;
+    virtual void set(uint8_t strand, uint16_t from, const uint8_t* rgb, uint16_t count) override;
+    virtual void transmit(uint8_t strand) override;
+    virtual void wait(uint8_t) override { }
+};
@@ -0,0 +1,346 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "LivePreview.h"
+
+#include "FrameBuffer.h"
+#include "FrameClock.h"
+#include "System.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const char* TAG = "LivePreview";
+
+// A browser which has gone away mustn't kill us with SIGPIPE
+#ifdef MSG_NOSIGNAL
+static constexpr int SendFlags = MSG_DONTWAIT | MSG_NOSIGNAL;
+#else
+static constexpr int SendFlags = MSG_DONTWAIT;
+#endif
+
+// Unchanged pixels between two runs which are sent to join them
+static constexpr uint16_t JoinGap = 1;
+static constexpr uint16_t MaxRun = 255;
+
+static const char* StreamHeader =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Access-Control-Allow-Origin: *\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+static const char* BusyResponse =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Access-Control-Allow-Origin: *\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+static const char* KeepAlive = ":\n\n";
+
+static void
+appendBase64(std::string& s, const uint8_t* data, size_t size)
+{
+    static const char* digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t n = uint32_t(data[i]) << 16;
+        if (i + 1 < size) {
+            n |= uint32_t(data[i + 1]) << 8;
+        }
+        if (i + 2 < size) {
+            n |= data[i + 2];
+        }
+        s += digits[(n >> 18) & 0x3f];
+        s += digits[(n >> 12) & 0x3f];
+        s += (i + 1 < size) ? digits[(n >> 6) & 0x3f] : '=';
+        s += (i + 2 < size) ? digits[n & 0x3f] : '=';
+    }
+}
+
+bool
+LivePreview::begin(uint16_t posts, uint16_t pixelsPerPost, uint16_t port)
+{
+    end();
+
+    _posts = posts;
+    _pixelsPerPost = pixelsPerPost;
+
+    _socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (_socket < 0) {
+        mil::System::logE(TAG, "Can't create socket");
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr = { };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(_socket, MaxClients) < 0) {
+        mil::System::logE(TAG, "Can't listen on port %d", int(port));
+        end();
+        return false;
+    }
+
+    _listening = true;
+    _listener = std::thread([this]() { listen(); });
+
+    mil::System::logI(TAG, "Listening on port %d", int(port));
+    return true;
+}
+
+void
+LivePreview::end()
+{
+    if (_listener.joinable()) {
+        _listening = false;
+        _listener.join();
+    }
+    if (_socket >= 0) {
+        close(_socket);
+        _socket = -1;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (Client& client : _clients) {
+        close(client.socket);
+    }
+    _clients.clear();
+    _numClients = 0;
+}
+
+void
+LivePreview::listen()
+{
+    while (_listening) {
+        // Wake up now and then to see if it's time to stop
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(_socket, &fds);
+        timeval timeout = { 0, 100000 };
+        if (select(_socket + 1, &fds, nullptr, nullptr, &timeout) > 0) {
+            accept();
+        }
+    }
+}
+
+void
+LivePreview::accept()
+{
+    int client = ::accept(_socket, nullptr, nullptr);
+    if (client < 0) {
+        return;
+    }
+
+#ifdef SO_NOSIGPIPE
+    int noSigPipe = 1;
+    setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+    // Whatever was asked for gets the stream, so the request is just read
+    // to the end of its headers. Don't wait long for it
+    timeval timeout = { 1, 0 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char buf[256];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 2048) {
+        ssize_t size = recv(client, buf, sizeof(buf), 0);
+        if (size <= 0) {
+            close(client);
+            return;
+        }
+        request.append(buf, size);
+    }
+
+    if (_numClients >= MaxClients) {
+        ::send(client, BusyResponse, strlen(BusyResponse), 0);
+        close(client);
+        _stats.refused++;
+        return;
+    }
+
+    std::string header = std::string(StreamHeader)
+                       + "event: topology\ndata: {\"posts\":" + std::to_string(_posts)
+                       + ",\"pixelsPerPost\":" + std::to_string(_pixelsPerPost) + "}\n\n";
+    if (::send(client, header.data(), header.size(), 0) != ssize_t(header.size())) {
+        close(client);
+        return;
+    }
+
+    // loop() sends everything it has next, straight away
+    std::lock_guard<std::mutex> lock(_mutex);
+    _clients.push_back({ client, std::string(), 0 });
+    _numClients = uint8_t(_clients.size());
+    _keyframe = true;
+    _stats.connects++;
+    _frameClock->wake();
+}
+
+void
+LivePreview::loop(const FrameBuffer& frameBuffer)
+{
+    if (_numClients == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    flush();
+
+    uint32_t now = mil::System::millis();
+    if (!_keyframe && int32_t(now - _lastSend) < int32_t(MinInterval)) {
+        return;
+    }
+    _lastSend = now;
+
+    // Worst case every other pixel changed, which is sent as runs of MaxRun
+    uint16_t numPixels = frameBuffer.numPixels();
+    bool all = _keyframe.exchange(false);
+    if (_last.size() != size_t(numPixels) * 3) {
+        _last.assign(size_t(numPixels) * 3, 0);
+        _runs.reserve(size_t(numPixels) * 3 + (numPixels / MaxRun + 1) * 3);
+        _message.reserve(8 + (_runs.capacity() + 2) / 3 * 4);
+        all = true;
+    }
+
+    if (!encode(frameBuffer.pixels(), numPixels, all)) {
+        if (int32_t(now - _lastKeepAlive) >= int32_t(KeepAliveInterval)) {
+            _lastKeepAlive = now;
+            send(KeepAlive, strlen(KeepAlive));
+        }
+        return;
+    }
+
+    _message = "data: ";
+    appendBase64(_message, _runs.data(), _runs.size());
+    _message += "\n\n";
+
+    _stats.frames++;
+    _stats.bytes += uint32_t(_message.size());
+    _lastKeepAlive = now;
+    send(_message.data(), _message.size());
+}
+
+bool
+LivePreview::encode(const uint8_t* pixels, uint16_t numPixels, bool all)
+{
+    _runs.clear();
+    uint8_t* last = _last.data();
+
+    auto changed = [all, pixels, last](uint16_t i)
+    {
+        return all || memcmp(pixels + i * 3, last + i * 3, 3) != 0;
+    };
+
+    for (uint16_t i = 0; i < numPixels; ) {
+        if (!changed(i)) {
+            ++i;
+            continue;
+        }
+
+        // Go on past short gaps of unchanged pixels
+        uint16_t first = i;
+        uint16_t end = i + 1;
+        for (uint16_t j = end; j < numPixels && j - first < MaxRun; ++j) {
+            if (changed(j)) {
+                end = j + 1;
+            } else if (j - end + 1 > JoinGap) {
+                break;
+            }
+        }
+
+        uint16_t count = end - first;
+        _runs.push_back(uint8_t(first));
+        _runs.push_back(uint8_t(first >> 8));
+        _runs.push_back(uint8_t(count));
+        _runs.insert(_runs.end(), pixels + first * 3, pixels + end * 3);
+        memcpy(last + first * 3, pixels + first * 3, count * 3);
+        i = end;
+    }
+
+    return !_runs.empty();
+}
+
+void
+LivePreview::send(const char* data, size_t size)
+{
+    for (size_t i = 0; i < _clients.size(); ) {
+        Client& client = _clients[i];
+        if (client.pending.size() - client.sent + size > MaxPending) {
+            drop(i);
+            continue;
+        }
+        
+        // Keep the buffer's space, rather than allocating every frame
+        client.pending.erase(0, client.sent);
+        client.sent = 0;
+        client.pending.append(data, size);
+        ++i;
+    }
+    flush();
+}
+
+void
+LivePreview::flush()
+{
+    // Never wait for a browser. One that's gone is dropped
+    for (size_t i = 0; i < _clients.size(); ) {
+        Client& client = _clients[i];
+        if (client.sent == client.pending.size()) {
+            ++i;
+            continue;
+        }
+        
+        ssize_t size = ::send(client.socket, client.pending.data() + client.sent, client.pending.size() - client.sent, SendFlags);
+        if (size < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            drop(i);
+            continue;
+        }
+        
+        if (size > 0) {
+            client.sent += size_t(size);
+            if (client.sent == client.pending.size()) {
+                client.pending.clear();
+                client.sent = 0;
+            }
+        }
+        ++i;
+    }
+}
+
+void
+LivePreview::drop(size_t index)
+{
+    close(_clients[index].socket);
+    _clients.erase(_clients.begin() + index);
+    _numClients = uint8_t(_clients.size());
+    _stats.dropped++;
+}
+
+std::string
+LivePreview::statsString() const
+{
+    return "preview clients=" + std::to_string(_numClients.load())
+         + " connects=" + std::to_string(_stats.connects.load())
+         + " refused=" + std::to_string(_stats.refused.load())
+         + " dropped=" + std::to_string(_stats.dropped)
+         + " frames=" + std::to_string(_stats.frames)
+         + " bytes=" + std::to_string(_stats.bytes);
+}
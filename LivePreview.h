@@ -0,0 +1,126 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// LivePreview Class
+//
+// Streams what's on the lights to browsers with Server-Sent Events, so
+// PostLightController.html can draw a live preview. It's a small HTTP
+// server of its own on DefaultPort, since the portal's server answers a
+// request and closes. Any GET gets the stream, starting with a topology
+// event:
+//
+//      event: topology
+//      data: {"posts":60,"pixelsPerPost":8}
+//
+// then a message for each frame which changed. Its data is base64 of
+// runs of changed pixels:
+//
+//      <first pixel, 16 bits little endian> <count> <count RGB pixels>
+//
+// The first message after a browser connects has every pixel. Frames are
+// sent at most every MinInterval ms and runs separated by a pixel or two
+// are joined, since a run costs as much as a pixel.
+//
+// A thread accepts browsers and wakes the FrameClock for the first frame.
+// With none connected loop() just checks a count, so the frame loop pays
+// nothing. Sends don't wait. What a browser's socket won't take yet, like
+// most of a keyframe for a big topology, is kept and sent over the next
+// frames. A browser which falls more than MaxPending bytes behind, or has
+// gone, is dropped. A comment is sent now and then to find ones which have
+// gone quietly.
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FrameBuffer;
+class FrameClock;
+
+class LivePreview
+{
+public:
+    static constexpr uint16_t DefaultPort = 8081;
+    static constexpr uint8_t MaxClients = 4;
+    static constexpr uint32_t MinInterval = 100; // ms between frames
+    static constexpr uint32_t KeepAliveInterval = 10000; // ms
+    static constexpr size_t MaxPending = 32768; // bytes waiting for a browser
+
+    struct Stats
+    {
+        std::atomic<uint32_t> connects { 0 };
+        std::atomic<uint32_t> refused { 0 };
+        uint32_t dropped = 0;
+        uint32_t frames = 0;
+        uint32_t bytes = 0;
+    };
+
+    LivePreview(FrameClock* frameClock) : _frameClock(frameClock) { }
+    ~LivePreview() { end(); }
+
+    // Start accepting browsers showing posts of pixelsPerPost pixels
+    bool begin(uint16_t posts, uint16_t pixelsPerPost, uint16_t port = DefaultPort);
+    void end();
+
+    // Call once a frame, after it's shown
+    void loop(const FrameBuffer&);
+
+    uint8_t numClients() const { return _numClients; }
+
+    const Stats& stats() const { return _stats; }
+    std::string statsString() const;
+
+private:
+    void listen();
+    void accept();
+
+    // Add the runs of pixels which differ from _last, or all of them, to
+    // _runs and update _last. Returns false if nothing changed
+    bool encode(const uint8_t* pixels, uint16_t numPixels, bool all);
+
+    struct Client
+    {
+        int socket;
+        std::string pending;
+        size_t sent = 0; // of pending
+    };
+
+    // Add data to what each browser is waiting for
+    void send(const char* data, size_t size);
+
+    // Send what each browser is waiting for, as far as its socket will take it
+    void flush();
+    void drop(size_t index);
+
+    FrameClock* _frameClock;
+    int _socket = -1;
+    std::thread _listener;
+    std::atomic<bool> _listening { false };
+    uint16_t _posts = 0;
+    uint16_t _pixelsPerPost = 0;
+
+    // Browsers are added by the listener and sent to and dropped by loop()
+    std::mutex _mutex;
+    std::vector<Client> _clients;
+    std::atomic<uint8_t> _numClients { 0 };
+    std::atomic<bool> _keyframe { false };
+
+    // Allocated when the first browser connects
+    std::vector<uint8_t> _last;
+    std::vector<uint8_t> _runs;
+    std::string _message;
+    uint32_t _lastSend = 0;
+    uint32_t _lastKeepAlive = 0;
+
+    Stats _stats;
+};
@@ -0,0 +1,444 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "LuaEffect.h"
+
+#include "ColorConvert.h"
+#include "LedAnimator.h"
+#include "NativeEffect.h"
+#include "SyncClock.h"
+#include "System.h"
+
+#include "lua.hpp"
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+static const char* TAG = "LuaEffect";
+
+// Registry key of the metatable which makes a script's math fall back to
+// the real one
+static const char* MathMetatable = "PLC.math";
+
+static int
+chunkWriter(lua_State*, const void* p, size_t size, void* data)
+{
+    reinterpret_cast<std::string*>(data)->append(reinterpret_cast<const char*>(p), size);
+    return 0;
+}
+
+static LuaEffect*
+self(lua_State* L)
+{
+    return reinterpret_cast<LuaEffect*>(lua_touserdata(L, lua_upvalueindex(1)));
+}
+
+LuaEffect::LuaEffect(FrameBuffer* frameBuffer)
+    : _frameBuffer(frameBuffer)
+    , _animator(new LedAnimator())
+{
+}
+
+LuaEffect::~LuaEffect()
+{
+    stop();
+    for (State& state : _states) {
+        if (state.L) {
+            lua_close(state.L);
+        }
+    }
+    delete _animator;
+}
+
+size_t
+LuaEffect::configure()
+{
+    // Warm states have the old topology in their globals
+    stop();
+    for (State& state : _states) {
+        if (state.L) {
+            lua_close(state.L);
+        }
+        state = State();
+    }
+    return _animator->configure(_frameBuffer->numPixels());
+}
+
+bool
+LuaEffect::init(const char* path, const uint8_t* args, uint16_t count)
+{
+    stop();
+
+    uint32_t startTime = mil::System::millis();
+
+    lua_State* L = getState();
+    if (!L) {
+        return false;
+    }
+
+    const Chunk* chunk = findChunk(L, path);
+    if (!chunk) {
+        _current->inUse = false;
+        _current = nullptr;
+        return false;
+    }
+
+    _thread = lua_newthread(L);
+    _threadRef = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    if (luaL_loadbufferx(L, chunk->code.data(), chunk->code.size(), path, "b") != LUA_OK) {
+        mil::System::logE(TAG, "Can't load '%s': %s", path, lua_tostring(L, -1));
+        lua_pop(L, 1);
+        stop();
+        return false;
+    }
+
+    // Give the script its own globals, falling back to the real ones
+    lua_newtable(L);
+    lua_newtable(L);
+    lua_pushglobaltable(L);
+    lua_setfield(L, -2, "__index");
+    lua_setmetatable(L, -2);
+
+    lua_newtable(L);
+    for (uint16_t i = 0; i < count; ++i) {
+        lua_pushinteger(L, args[i]);
+        lua_seti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "arg");
+
+    // And its own math, with our random and the rest from the real one.
+    // Changing the shared table would change it for anything else in the
+    // state
+    lua_newtable(L);
+    lua_pushcfunction(L, random);
+    lua_setfield(L, -2, "random");
+    lua_getfield(L, LUA_REGISTRYINDEX, MathMetatable);
+    lua_setmetatable(L, -2);
+    lua_setfield(L, -2, "math");
+
+    // A main chunk's first upvalue is _ENV
+    lua_setupvalue(L, -2, 1);
+    lua_xmove(L, _thread, 1);
+
+    _stats.lastStartMs = mil::System::millis() - startTime;
+    return true;
+}
+
+int32_t
+LuaEffect::loop()
+{
+    if (!_thread) {
+        return -1;
+    }
+
+    int numResults = 0;
+    int status = lua_resume(_thread, _current->L, 0, &numResults);
+
+    if (status == LUA_YIELD) {
+        // Yielded from delay(), with the ms to wait
+        int32_t delayInMs = (numResults > 0) ? int32_t(lua_tointeger(_thread, -1)) : 0;
+        lua_pop(_thread, numResults);
+        return (delayInMs < 1) ? 1 : delayInMs;
+    }
+
+    if (status != LUA_OK) {
+        mil::System::logE(TAG, "Lua effect error: %s", lua_tostring(_thread, -1));
+    }
+
+    stop();
+    return -1;
+}
+
+void
+LuaEffect::stop()
+{
+    if (!_current) {
+        return;
+    }
+
+    // Dropping the thread frees everything the script made, collect
+    // it later while the state is idle
+    luaL_unref(_current->L, LUA_REGISTRYINDEX, _threadRef);
+    _thread = nullptr;
+    _threadRef = -1;
+
+    _current->inUse = false;
+    _current->needsCollect = true;
+    _current = nullptr;
+}
+
+const LuaEffect::Chunk*
+LuaEffect::findChunk(lua_State* L, const char* path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return nullptr;
+    }
+
+    Chunk* oldest = &_chunks[0];
+    for (Chunk& chunk : _chunks) {
+        if (chunk.path == path) {
+            if (chunk.mtime == int64_t(st.st_mtime) && chunk.size == int64_t(st.st_size)) {
+                chunk.lastUsed = ++_useCount;
+                _stats.cacheHits++;
+                return &chunk;
+            }
+
+            // Changed, replace this one
+            oldest = &chunk;
+            break;
+        }
+        if (chunk.lastUsed < oldest->lastUsed) {
+            oldest = &chunk;
+        }
+    }
+
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return nullptr;
+    }
+
+    std::string source(size_t(st.st_size), '\0');
+    size_t size = fread(&source[0], 1, source.size(), f);
+    fclose(f);
+
+    std::string name = std::string("@") + path;
+    if (luaL_loadbufferx(L, source.data(), size, name.c_str(), "t") != LUA_OK) {
+        mil::System::logE(TAG, "Can't compile '%s': %s", path, lua_tostring(L, -1));
+        lua_pop(L, 1);
+        return nullptr;
+    }
+
+    oldest->code.clear();
+    lua_dump(L, chunkWriter, &oldest->code, 0);
+    lua_pop(L, 1);
+
+    oldest->path = path;
+    oldest->mtime = int64_t(st.st_mtime);
+    oldest->size = int64_t(st.st_size);
+    oldest->lastUsed = ++_useCount;
+    _stats.compiles++;
+    return oldest;
+}
+
+lua_State*
+LuaEffect::getState()
+{
+    // Prefer a warm state which has already been cleaned up. The one just
+    // stopped usually hasn't, so make another while there's room, rather
+    // than collecting it all now. Only when every state is waiting to be
+    // collected is one collected in full
+    State* state = nullptr;
+    State* empty = nullptr;
+    for (State& s : _states) {
+        if (!s.L) {
+            if (!empty) {
+                empty = &s;
+            }
+        } else if (!s.inUse && (!state || state->needsCollect)) {
+            state = &s;
+        }
+    }
+
+    if (state && (!state->needsCollect || !empty)) {
+        if (state->needsCollect) {
+            lua_gc(state->L, LUA_GCCOLLECT);
+            state->needsCollect = false;
+        }
+        _stats.statesReused++;
+    } else {
+        state = empty;
+        if (!state) {
+            return nullptr;
+        }
+
+        lua_State* L = luaL_newstate();
+        if (!L) {
+            return nullptr;
+        }
+        luaL_openlibs(L);
+
+        const luaL_Reg funcs[ ] =
+        {
+            { "setLED", setLED },
+            { "hsvToRGB", hsvToRGB },
+            { "refreshLEDs", refreshLEDs },
+            { "millis", millis },
+            { "delay", delay },
+            { nullptr, nullptr },
+        };
+
+        const luaL_Reg animatorFuncs[ ] =
+        {
+            { "setup", animatorSetup },
+            { "set", animatorSet },
+            { "respawn", animatorRespawn },
+            { "step", animatorStep },
+            { nullptr, nullptr },
+        };
+
+        lua_pushglobaltable(L);
+        lua_pushlightuserdata(L, this);
+        luaL_setfuncs(L, funcs, 1);
+        lua_pop(L, 1);
+
+        lua_newtable(L);
+        lua_pushlightuserdata(L, this);
+        luaL_setfuncs(L, animatorFuncs, 1);
+        lua_setglobal(L, "animator");
+
+        lua_pushinteger(L, _frameBuffer->topology().numPosts());
+        lua_setglobal(L, "numPosts");
+        lua_pushinteger(L, _frameBuffer->pixelsPerPost());
+        lua_setglobal(L, "pixelsPerPost");
+        lua_pushinteger(L, _frameBuffer->numPixels());
+        lua_setglobal(L, "numPixels");
+
+        // Scripts get a math which uses the same generator as the native
+        // effects, so a fixed seed gives the same frames from either
+        // engine. This makes the rest of it come from the real math
+        lua_newtable(L);
+        lua_getglobal(L, "math");
+        lua_setfield(L, -2, "__index");
+        lua_setfield(L, LUA_REGISTRYINDEX, MathMetatable);
+
+        state->L = L;
+        _stats.statesCreated++;
+    }
+
+    state->inUse = true;
+    _current = state;
+    return state->L;
+}
+
+void
+LuaEffect::collectIdle()
+{
+    for (State& state : _states) {
+        if (!state.inUse && state.needsCollect && lua_gc(state.L, LUA_GCSTEP, 0)) {
+            // Finished a cycle
+            state.needsCollect = false;
+        }
+    }
+}
+
+// setLED(strand, index, r, g, b)
+int
+LuaEffect::setLED(lua_State* L)
+{
+    uint16_t i = uint16_t(luaL_checkinteger(L, 2));
+    uint8_t r = uint8_t(luaL_checknumber(L, 3));
+    uint8_t g = uint8_t(luaL_checknumber(L, 4));
+    uint8_t b = uint8_t(luaL_checknumber(L, 5));
+    self(L)->_frameBuffer->setLights(i, 1, r, g, b);
+    return 0;
+}
+
+// r, g, b = hsvToRGB(h, s, v)
+int
+LuaEffect::hsvToRGB(lua_State* L)
+{
+    uint8_t r, g, b;
+    ColorConvert::hsvToRGB(uint8_t(luaL_checknumber(L, 1)), uint8_t(luaL_checknumber(L, 2)), uint8_t(luaL_checknumber(L, 3)), r, g, b);
+    lua_pushinteger(L, r);
+    lua_pushinteger(L, g);
+    lua_pushinteger(L, b);
+    return 3;
+}
+
+// refreshLEDs(strand)
+int
+LuaEffect::refreshLEDs(lua_State* L)
+{
+    self(L)->_frameBuffer->show();
+    return 0;
+}
+
+int
+LuaEffect::millis(lua_State* L)
+{
+    const SyncClock* clock = self(L)->_clock;
+    lua_pushinteger(L, clock ? clock->millis() : mil::System::millis());
+    return 1;
+}
+
+// math.random([m [, n]]), backed by NativeEffect::irand
+int
+LuaEffect::random(lua_State* L)
+{
+    switch (lua_gettop(L)) {
+        case 0: lua_pushnumber(L, lua_Number(NativeEffect::irand(0, 32767)) / 32768); break;
+        case 1: lua_pushinteger(L, NativeEffect::irand(1, int16_t(luaL_checkinteger(L, 1)))); break;
+        default: lua_pushinteger(L, NativeEffect::irand(int16_t(luaL_checkinteger(L, 1)), int16_t(luaL_checkinteger(L, 2)))); break;
+    }
+    return 1;
+}
+
+// delay(ms) yields back to loop(), which returns ms
+int
+LuaEffect::delay(lua_State* L)
+{
+    lua_Integer ms = luaL_checkinteger(L, 1);
+    lua_pushinteger(L, ms);
+    return lua_yield(L, 1);
+}
+
+// animator.setup(count, channel)
+int
+LuaEffect::animatorSetup(lua_State* L)
+{
+    uint16_t count = uint16_t(luaL_checkinteger(L, 1));
+    const char* channel = luaL_optstring(L, 2, "v");
+    if (!self(L)->_animator->setup(count, (channel[0] == 'h') ? LedAnimator::Channel::Hue : LedAnimator::Channel::Value)) {
+        return luaL_error(L, "animator.setup: bad count %d", int(count));
+    }
+    return 0;
+}
+
+// animator.set(i, cur, inc, min, max)
+int
+LuaEffect::animatorSet(lua_State* L)
+{
+    self(L)->_animator->set(uint16_t(luaL_checkinteger(L, 1) - 1),
+                            int16_t(luaL_checkinteger(L, 2)), int16_t(luaL_checkinteger(L, 3)),
+                            int16_t(luaL_checkinteger(L, 4)), int16_t(luaL_checkinteger(L, 5)));
+    return 0;
+}
+
+// animator.respawn(cur, incMin, incMax, maxMin, maxMax)
+int
+LuaEffect::animatorRespawn(lua_State* L)
+{
+    self(L)->_animator->setRespawn(uint8_t(luaL_checkinteger(L, 1)),
+                                   uint8_t(luaL_checkinteger(L, 2)), uint8_t(luaL_checkinteger(L, 3)),
+                                   uint8_t(luaL_checkinteger(L, 4)), uint8_t(luaL_checkinteger(L, 5)));
+    return 0;
+}
+
+// animator.step(h, s, v)
+int
+LuaEffect::animatorStep(lua_State* L)
+{
+    LuaEffect* effect = self(L);
+    effect->_animator->step();
+    effect->_animator->render(effect->_frameBuffer, uint8_t(luaL_checknumber(L, 1)),
+                              uint8_t(luaL_checknumber(L, 2)), uint8_t(luaL_checknumber(L, 3)));
+    return 0;
+}
+
+std::string
+LuaEffect::statsString() const
+{
+    return "compiles=" + std::to_string(_stats.compiles)
+         + " cacheHits=" + std::to_string(_stats.cacheHits)
+         + " statesCreated=" + std::to_string(_stats.statesCreated)
+         + " statesReused=" + std::to_string(_stats.statesReused)
+         + " lastStart=" + std::to_string(_stats.lastStartMs) + "ms";
+}
@@ -0,0 +1,130 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// LuaEffect Class
+//
+// Runs a Lua effect script (e.g., f.lua) in process rather than as a
+// shell command, so switching effects doesn't parse, compile and create
+// a new Lua state each time.
+//
+// Compiled chunks are cached, keyed by path, mtime and size, and reloaded
+// from bytecode. Scripts run as coroutines in a small pool of warm Lua
+// states which keep their libraries and bindings loaded. Each run gets
+// its own global table so nothing leaks from one script to the next. The
+// garbage left by a finished script is collected a step at a time by
+// collectIdle() while its state is idle, and a script is started in
+// another state meanwhile. Call collectIdle() once a frame, whatever
+// effect is running.
+//
+// Scripts see the same functions they do as a shell command: setLED,
+// hsvToRGB, refreshLEDs, millis and delay, with args in 'arg'. delay()
+// yields, and loop() returns the ms it was passed, like any other effect.
+// millis is the SyncClock's time if one is set, so scripts on controllers
+// which share a clock stay in phase.
+// The topology is in the globals numPosts, pixelsPerPost and numPixels.
+//
+// Scripts can also use the native LedAnimator (see LedAnimator.h) rather
+// than animating pixels in Lua:
+//
+//      animator.setup(count, channel)          channel is "h" or "v" (default)
+//      animator.set(i, cur, inc, min, max)     i from 1 to count, fixed point values
+//      animator.respawn(cur, incMin, incMax, maxMin, maxMax)
+//      animator.step(h, s, v)                  step all entries and set the LEDs
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "FrameBuffer.h"
+
+class LedAnimator;
+class SyncClock;
+struct lua_State;
+
+class LuaEffect
+{
+public:
+    struct Stats
+    {
+        uint32_t compiles = 0;
+        uint32_t cacheHits = 0;
+        uint32_t statesCreated = 0;
+        uint32_t statesReused = 0;
+        uint32_t lastStartMs = 0; // Time from init() to the first yield
+    };
+
+    LuaEffect(FrameBuffer* frameBuffer);
+    ~LuaEffect();
+
+    // Size for the FrameBuffer's topology. Returns the number of bytes allocated
+    size_t configure();
+
+    void setClock(const SyncClock* clock) { _clock = clock; }
+
+    // Returns false if the script doesn't exist or fails to start
+    bool init(const char* path, const uint8_t* args, uint16_t count);
+    int32_t loop();
+    void stop();
+
+    // Do a step of collecting the garbage in states which aren't in use
+    void collectIdle();
+
+    const Stats& stats() const { return _stats; }
+    std::string statsString() const;
+
+private:
+    static constexpr uint8_t MaxChunks = 8;
+    static constexpr uint8_t NumStates = 2;
+
+    struct Chunk
+    {
+        std::string path;
+        int64_t mtime = 0;
+        int64_t size = 0;
+        std::string code;
+        uint32_t lastUsed = 0;
+    };
+
+    struct State
+    {
+        lua_State* L = nullptr;
+        bool inUse = false;
+        bool needsCollect = false;
+    };
+
+    const Chunk* findChunk(lua_State*, const char* path);
+    lua_State* getState();
+
+    static int setLED(lua_State*);
+    static int hsvToRGB(lua_State*);
+    static int refreshLEDs(lua_State*);
+    static int millis(lua_State*);
+    static int delay(lua_State*);
+    static int random(lua_State*);
+
+    static int animatorSetup(lua_State*);
+    static int animatorSet(lua_State*);
+    static int animatorRespawn(lua_State*);
+    static int animatorStep(lua_State*);
+
+    FrameBuffer* _frameBuffer;
+    LedAnimator* _animator;
+    const SyncClock* _clock = nullptr;
+
+    Chunk _chunks[MaxChunks];
+    uint32_t _useCount = 0;
+
+    State _states[NumStates];
+    State* _current = nullptr;
+    lua_State* _thread = nullptr;
+    int _threadRef = -1;
+
+    Stats _stats;
+};
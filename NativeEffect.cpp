@@ -0,0 +1,360 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "NativeEffect.h"
+
+uint32_t NativeEffect::_seed = 1;
+
+int8_t
+NativeEffect::animate(LedEntry& led)
+{
+    // Watch for overflow
+    if (led.inc > 0) {
+        if (led.cur >= led.max - led.inc) {
+            led.inc = -led.inc;
+            led.cur = led.max;
+            return 1;
+        }
+    } else {
+        if (led.cur <= led.min - led.inc) {
+            led.inc = -led.inc;
+            led.cur = led.min;
+            return -1;
+        }
+    }
+
+    led.cur += led.inc;
+    return 0;
+}
+
+int16_t
+NativeEffect::irand(int16_t min, int16_t max)
+{
+    if (max <= min) {
+        return min;
+    }
+
+    // xorshift32
+    _seed ^= _seed << 13;
+    _seed ^= _seed >> 17;
+    _seed ^= _seed << 5;
+    return min + int16_t(_seed % uint32_t(int32_t(max) - min + 1));
+}
+
+void
+NativeEffect::setPost(uint16_t post, uint8_t h, uint8_t s, uint8_t v)
+{
+    uint8_t r, g, b;
+    ColorConvert::hsvToRGB(h, s, v, r, g, b);
+    _frameBuffer->setPost(post, r, g, b);
+}
+
+//
+// Flicker
+//
+// Flicker inc value. This is a random value based on speed.
+// Speed goes from 0-7 for flicker. Min and max values are
+// from 0 to 255 multiplied by 128. so a typical range is
+// 15000. If we want to animate 15000 values in 1 second
+// at 25ms per cycle, the inc value would be 375. These
+// table entries are /128 (so they fit in a byte)
+//
+struct FlickerSpeedEntry
+{
+    uint8_t min;
+    uint8_t max;
+};
+
+static constexpr FlickerSpeedEntry FlickerSpeedTable[ ] =
+{
+    { 1, 2 },
+    { 2, 3 },
+    { 3, 4 },
+    { 4, 6 },
+    { 6, 8 },
+    { 8, 10 },
+    { 10, 13 },
+    { 13, 16 },
+};
+
+static constexpr int16_t FlickerMin = 38;
+static constexpr int16_t FlickerBrightestMin = 77;
+
+bool
+FlickerEffect::initEffect(const uint8_t* buf, uint16_t size)
+{
+    _color = colorArg(buf, size, 0);
+    _speed = arg(buf, size, 3);
+    if (_speed > 7) {
+        _speed = 7;
+    }
+
+    _brightnessMax = (_color.v < FlickerBrightestMin) ? FlickerBrightestMin : _color.v;
+
+    // All zeros makes animate return -1 on the first loop, which picks
+    // a new random throb for every pixel
+    for (uint16_t i = 0; i < numPixels(); ++i) {
+        _leds[i] = { 0, 0, 0, 0 };
+    }
+    return true;
+}
+
+int32_t
+FlickerEffect::loop()
+{
+    for (uint16_t i = 0; i < numPixels(); ++i) {
+        LedEntry& led = _leds[i];
+        if (animate(led) == -1) {
+            // We are done with the throb. We always start at FlickerMin.
+            // Select a new inc (how fast it pulses), and  max (how bright it
+            // gets) based on the speed value.
+            led.cur = FlickerMin * 128;
+            led.min = led.cur;
+            led.inc = irand(FlickerSpeedTable[_speed].min, FlickerSpeedTable[_speed].max) * 128;
+            led.max = irand(FlickerBrightestMin, _brightnessMax) * 128;
+        }
+
+        _frame[i] = { _color.h, _color.s, uint8_t(led.cur / 128) };
+    }
+
+    setFrame(_frame);
+    return Delay;
+}
+
+//
+// Pulse
+//
+static constexpr int16_t PulseMin = 38;
+static constexpr int16_t NumLevels = 8;
+static constexpr int16_t PulseSpeedMult = 35;
+
+bool
+PulseEffect::initEffect(const uint8_t* buf, uint16_t size)
+{
+    _color = colorArg(buf, size, 0);
+    uint8_t speed = arg(buf, size, 3);
+    if (speed > 7) {
+        speed = 7;
+    }
+
+    for (uint16_t post = 0; post < _numPosts; ++post) {
+        LedEntry& led = _leds[post];
+
+        // min is from PulseMin which is the level at which the light is dim
+        // but not off and doesn't flicker from being too dim.
+        led.min = PulseMin * 128;
+        led.max = int16_t(_color.v) * 128;
+
+        // max is based on the color brightness, but it can't be dimmer than
+        // the min value. If it is, brighten it up a bit
+        if (led.max <= led.min) {
+            led.max = led.min + led.min / 2;
+        }
+
+        led.inc = (led.max - led.min) / ((NumLevels - speed) * PulseSpeedMult);
+        if (led.inc == 0) {
+            led.inc = 1;
+        }
+
+        // Start with a random value for cur so the posts aren't in sync
+        led.cur = irand(led.min, led.max);
+    }
+    return true;
+}
+
+int32_t
+PulseEffect::loop()
+{
+    for (uint16_t post = 0; post < _numPosts; ++post) {
+        LedEntry& led = _leds[post];
+        animate(led);
+        setPost(post, _color.h, _color.s, uint8_t(led.cur / 128));
+    }
+
+    return Delay;
+}
+
+//
+// MultiColor
+//
+static constexpr int16_t FadeInc = 5;
+
+int16_t
+MultiColorEffect::randomDuration() const
+{
+    // Add randomness to duration so the posts don't stay in sync
+    int16_t seconds = int16_t(_speed) + 4 + irand(-3, 3);
+    return seconds * (1000 / Delay);
+}
+
+void
+MultiColorEffect::initFade(uint16_t post, bool fadeIn)
+{
+    LedEntry& led = _leds[post];
+
+    led.min = 0;
+    led.max = int16_t(_colors[_index[post]].v) * 128;
+    led.cur = 0;
+    led.inc = FadeInc * 128;
+
+    if (!fadeIn) {
+        led.cur = led.max;
+        led.inc = -led.inc;
+    }
+}
+
+bool
+MultiColorEffect::initEffect(const uint8_t* buf, uint16_t size)
+{
+    for (uint8_t i = 0; i < NumColors; ++i) {
+        _colors[i] = colorArg(buf, size, i * 3);
+    }
+    _speed = arg(buf, size, NumColors * 3);
+
+    for (uint16_t post = 0; post < _numPosts; ++post) {
+        _durationCur[post] = randomDuration();
+
+        // Start on a random color and fade it in
+        _index[post] = irand(0, NumColors - 1);
+        initFade(post, true);
+        _isCrossfading[post] = true;
+    }
+    return true;
+}
+
+int32_t
+MultiColorEffect::loop()
+{
+    for (uint16_t post = 0; post < _numPosts; ++post) {
+        LedEntry& led = _leds[post];
+
+        if (_isCrossfading[post]) {
+            int8_t animateResult = animate(led);
+            if (animateResult < 0) {
+                // The current light has faded out, fade in the next one
+                if (++_index[post] >= NumColors) {
+                    _index[post] = 0;
+                }
+                initFade(post, true);
+            } else if (animateResult > 0) {
+                // The new light has completed fading in
+                _isCrossfading[post] = false;
+            }
+        } else if (--_durationCur[post] <= 0) {
+            // We've hit the desired duration, transition
+            _isCrossfading[post] = true;
+            _durationCur[post] = randomDuration();
+        }
+
+        const Color& color = _colors[_index[post]];
+        setPost(post, color.h, color.s, uint8_t(led.cur / 128));
+    }
+
+    return Delay;
+}
+
+//
+// Rainbow
+//
+static constexpr int16_t MaxColorComp = 255 * 128; // Hue of 255 in fixed point
+static constexpr int16_t RainbowSpeedMult = 1;
+
+bool
+RainbowEffect::initEffect(const uint8_t* buf, uint16_t size)
+{
+    _color = colorArg(buf, size, 0);
+    uint8_t speed = arg(buf, size, 3);
+    if (speed > 15) {
+        speed = 15;
+    }
+    _range = arg(buf, size, 4);
+    if (_range > 7) {
+        _range = 7;
+    }
+
+    for (uint16_t post = 0; post < _numPosts; ++post) {
+        LedEntry& led = _leds[post];
+
+        // Go from starting hue (min) to a color with a greater value
+        // of hue. A range of 0 is a small change, 6 is the largest
+        // change, 7 ignores the starting hue and goes full range
+        if (_range < 7) {
+            led.min = int16_t(_color.h) * 128;
+            led.max = led.min + (MaxColorComp - led.min) / (8 - _range);
+        } else {
+            led.min = 0;
+            led.max = MaxColorComp;
+        }
+
+        led.inc = int16_t(speed + 1) * RainbowSpeedMult;
+
+        // Start with a random value for cur so the posts aren't in sync
+        led.cur = irand(led.min, led.max);
+    }
+    return true;
+}
+
+int32_t
+RainbowEffect::loop()
+{
+    for (uint16_t post = 0; post < _numPosts; ++post) {
+        LedEntry& led = _leds[post];
+
+        if (_range < 7) {
+            animate(led);
+        } else {
+            // Full range loops around the color wheel rather than bouncing
+            led.cur += led.inc;
+            if (led.cur >= led.max) {
+                led.cur -= led.max;
+            }
+        }
+
+        setPost(post, uint8_t(led.cur / 128), _color.s, _color.v);
+    }
+
+    return Delay;
+}
+
+//
+// NativeEffects
+//
+size_t
+NativeEffects::configure(const Topology& topology)
+{
+    return _flicker.configure(topology)
+         + _pulse.configure(topology)
+         + _multiColor.configure(topology)
+         + _rainbow.configure(topology);
+}
+
+NativeEffect*
+NativeEffects::find(uint8_t cmd)
+{
+    struct Entry
+    {
+        uint8_t cmd;
+        NativeEffect* effect;
+    };
+
+    const Entry entries[ ] =
+    {
+        { 'f', &_flicker },
+        { 'p', &_pulse },
+        { 'm', &_multiColor },
+        { 'r', &_rainbow },
+    };
+
+    for (const Entry& entry : entries) {
+        if (entry.cmd == cmd) {
+            return entry.effect;
+        }
+    }
+    return nullptr;
+}
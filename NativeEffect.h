@@ -0,0 +1,220 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// NativeEffect Classes
+//
+// Native C++ versions of the effects in PostLightEffects.clvr and f.lua.
+// These run directly from sendCmd without starting a Lua script. Like
+// Flash, each effect has an init() which takes the command params and
+// a loop() which returns the number of ms to wait before calling it again.
+// Effects write to a FrameBuffer. The caller shows it after loop().
+//
+// NativeEffects holds one instance of each effect and maps a command char
+// to it. Effects size their state for the Topology once, at boot, and
+// never allocate while running.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "ColorConvert.h"
+#include "FrameBuffer.h"
+#include "Topology.h"
+
+class NativeEffect
+{
+public:
+    virtual ~NativeEffect() { }
+
+    // Returns the number of bytes allocated
+    size_t configure(const Topology& topology)
+    {
+        _numPosts = topology.numPosts();
+        _pixelsPerPost = topology.pixelsPerPost();
+        return allocate();
+    }
+
+    // buf/size are the params after the cmd char
+    bool init(FrameBuffer* frameBuffer, const uint8_t* buf, uint16_t size)
+    {
+        if (_numPosts == 0) {
+            return false;
+        }
+        _frameBuffer = frameBuffer;
+        return initEffect(buf, size);
+    }
+
+    virtual int32_t loop() = 0;
+
+    static void seed(uint32_t s) { _seed = s ? s : 1; }
+
+    // Random value from min to max inclusive
+    static int16_t irand(int16_t min, int16_t max);
+
+protected:
+    static constexpr int32_t Delay = 25; // Delay between calls to loop (in ms)
+
+    // Animation values are 16 bit integers, representing a fixed point
+    // number, with 9 bits representing the signed integer part and 7
+    // bits for the fraction. To get a brightness value from 'cur' you
+    // simply shift right 7 places or divide by 128.
+    struct LedEntry
+    {
+        int16_t cur;
+        int16_t inc;
+        int16_t min;
+        int16_t max;
+    };
+
+    using Color = ColorConvert::HSV;
+
+    // Returns 1 when cur hits max, -1 when it hits min and 0 otherwise.
+    // Direction is reversed at each end
+    static int8_t animate(LedEntry& led);
+
+    static uint8_t arg(const uint8_t* buf, uint16_t size, uint16_t i) { return (i < size) ? buf[i] : 0; }
+    static Color colorArg(const uint8_t* buf, uint16_t size, uint16_t i)
+    {
+        return { arg(buf, size, i), arg(buf, size, i + 1), arg(buf, size, i + 2) };
+    }
+
+    virtual bool initEffect(const uint8_t* buf, uint16_t size) = 0;
+    virtual size_t allocate() = 0;
+
+    template<typename T>
+    static size_t resize(T*& array, uint16_t count)
+    {
+        delete [ ] array;
+        array = new T[count]();
+        return count * sizeof(T);
+    }
+
+    uint16_t numPixels() const { return _numPosts * _pixelsPerPost; }
+
+    // Set every light on a post to one color
+    void setPost(uint16_t post, uint8_t h, uint8_t s, uint8_t v);
+
+    // Set all the lights from hsv, converting them all in one call
+    void setFrame(const Color* hsv) { _frameBuffer->setLightsHSV(0, hsv, numPixels()); }
+
+    uint16_t _numPosts = 0;
+    uint16_t _pixelsPerPost = 0;
+
+private:
+    static uint32_t _seed;
+    FrameBuffer* _frameBuffer = nullptr;
+};
+
+// 'f' - Flicker: Single color flickers randomly at passed speed
+//      Args:   0, 1, 2     Color
+//              3           Speed (0-7)
+class FlickerEffect : public NativeEffect
+{
+public:
+    virtual ~FlickerEffect() { delete [ ] _leds; delete [ ] _frame; }
+    virtual int32_t loop() override;
+
+private:
+    virtual bool initEffect(const uint8_t* buf, uint16_t size) override;
+    virtual size_t allocate() override { return resize(_leds, numPixels()) + resize(_frame, numPixels()); }
+
+    Color _color;
+    uint8_t _speed = 0;
+    uint8_t _brightnessMax = 0;
+    LedEntry* _leds = nullptr; // One per pixel
+    Color* _frame = nullptr;
+};
+
+// 'p' - Pulse: Single color pulses dim and bright at passed speed
+//      Args:   0, 1, 2     Color
+//              3           Speed (0-7)
+class PulseEffect : public NativeEffect
+{
+public:
+    virtual ~PulseEffect() { delete [ ] _leds; }
+    virtual int32_t loop() override;
+
+private:
+    virtual bool initEffect(const uint8_t* buf, uint16_t size) override;
+    virtual size_t allocate() override { return resize(_leds, _numPosts); }
+
+    Color _color;
+    LedEntry* _leds = nullptr; // One per post
+};
+
+// 'm' - Multicolor: rotate between 4 passed color at passed rate
+//      Args:   0..2       Color 1
+//              3..5       Color 2
+//              6..8       Color 3
+//              9..11      Color 4
+//              12         Speed between cross fades in 1 second intervals (0-255)
+class MultiColorEffect : public NativeEffect
+{
+public:
+    virtual ~MultiColorEffect() { delete [ ] _leds; delete [ ] _durationCur; delete [ ] _index; delete [ ] _isCrossfading; }
+    virtual int32_t loop() override;
+
+private:
+    virtual bool initEffect(const uint8_t* buf, uint16_t size) override;
+    virtual size_t allocate() override
+    {
+        return resize(_leds, _numPosts) + resize(_durationCur, _numPosts) + resize(_index, _numPosts) + resize(_isCrossfading, _numPosts);
+    }
+
+    static constexpr uint8_t NumColors = 4;
+
+    void initFade(uint16_t post, bool fadeIn);
+    int16_t randomDuration() const;
+
+    Color _colors[NumColors];
+    uint8_t _speed = 0;
+    
+    // One per post
+    LedEntry* _leds = nullptr;
+    int16_t* _durationCur = nullptr;
+    uint8_t* _index = nullptr;
+    bool* _isCrossfading = nullptr;
+};
+
+// 'r' - Rainbow: cycle colors through part of entire rainbow at passed speed
+//      Args:   0, 1, 2     Color
+//              3           Speed of color change (0-15)
+//              4           Range how far from passed color to change.
+//                          0 - small change, 7 - full range
+//                          0-6 colors bounce back and forth, 7 colors loop around
+class RainbowEffect : public NativeEffect
+{
+public:
+    virtual ~RainbowEffect() { delete [ ] _leds; }
+    virtual int32_t loop() override;
+
+private:
+    virtual bool initEffect(const uint8_t* buf, uint16_t size) override;
+    virtual size_t allocate() override { return resize(_leds, _numPosts); }
+
+    Color _color;
+    uint8_t _range = 0;
+    LedEntry* _leds = nullptr; // One per post
+};
+
+class NativeEffects
+{
+public:
+    // Size every effect for topology. Returns the number of bytes allocated
+    size_t configure(const Topology&);
+
+    // Returns nullptr if there is no native implementation of cmd
+    NativeEffect* find(uint8_t cmd);
+
+private:
+    FlickerEffect _flicker;
+    PulseEffect _pulse;
+    MultiColorEffect _multiColor;
+    RainbowEffect _rainbow;
+};
@@ -13,9 +13,17 @@ All rights reserved.
 
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
+
+#include "ColorConvert.h"
+#include "DirtyTracker.h"
 
 #if defined ARDUINO
 #include <Adafruit_NeoPixel.h>
+#elif !defined ESP_PLATFORM
+#include "FrameTrace.h"
+#include <chrono>
+#include <memory>
 #endif
 
 namespace mil {
@@ -25,29 +33,123 @@ namespace mil {
 class NeoPixel
 {
 public:
-    NeoPixel(uint16_t numPixels, uint8_t ledPin) : _pixels(numPixels, ledPin, NEO_GRB + NEO_KHZ800) { }
+    NeoPixel(uint16_t numPixels, uint8_t ledPin, uint16_t pixelsPerPost = 0)
+        : _pixels(numPixels, ledPin, NEO_GRB + NEO_KHZ800)
+        , _shadow(new uint8_t[numPixels * 3]())
+        , _dirty(pixelsPerPost ? pixelsPerPost : numPixels)
+    {
+        _dirty.mark(0, numPixels);
+    }
+    
+    ~NeoPixel() { delete [ ] _shadow; }
+    
+    NeoPixel(const NeoPixel&) = delete;
+    NeoPixel& operator=(const NeoPixel&) = delete;
 
     void begin() { _pixels.begin(); }
     void setBrightness(uint8_t b) { _pixels.setBrightness(b); }
     uint16_t numPixels() const { return _pixels.numPixels(); }
-    void show() { _pixels.show(); }
     
+    // Skip the refresh if nothing changed, otherwise stop after the
+    // last changed pixel. show() turns off interrupts so the less
+    // we send the better.
+    void show()
+    {
+        if (!_dirty.dirty()) {
+            _dirty.skipped();
+            return;
+        }
+        
+        uint16_t count = _dirty.last() + 1;
+        _pixels.show(count);
+        _dirty.refreshed(count < numPixels());
+        _dirty.clear();
+    }
+    
+    // Changes are found by comparing with a shadow copy of the RGB values
+    // set, since getPixelColor() is lossy once setBrightness() is used
     void setLight(uint16_t i, uint32_t color)
     {
-        _pixels.setPixelColor(i, color);
+        if (i < numPixels() && setShadow(i, uint8_t(color >> 16), uint8_t(color >> 8), uint8_t(color))) {
+            _pixels.setPixelColor(i, color);
+            _dirty.mark(i, 1);
+        }
     }
     
     void setLights(uint16_t from, uint16_t count, uint32_t color)
     {
         for (int i = 0; i < count; ++i) {
-            _pixels.setPixelColor(from + i, color);
+            setLight(from + i, color);
+        }
+    }
+    
+    // Convert count HSV values straight into the wire buffer (GRB). This
+    // bypasses setBrightness scaling. Lights past the end are ignored, like
+    // setPixelColor() does
+    void setLightsHSV(uint16_t from, const ColorConvert::HSV* hsv, uint16_t count)
+    {
+        static constexpr uint16_t ChunkSize = 8;
+        uint8_t rgb[ChunkSize * 3];
+        uint8_t* pixels = _pixels.getPixels();
+        
+        while (count > 0 && from < numPixels()) {
+            uint16_t n = (count < ChunkSize) ? count : ChunkSize;
+            if (n > numPixels() - from) {
+                n = numPixels() - from;
+            }
+            ColorConvert::hsvToPixels(hsv, rgb, n);
+            for (uint16_t i = 0; i < n; ++i) {
+                const uint8_t* c = rgb + i * 3;
+                if (setShadow(from + i, c[0], c[1], c[2])) {
+                    uint8_t* p = pixels + (from + i) * 3;
+                    p[0] = c[1];
+                    p[1] = c[0];
+                    p[2] = c[2];
+                    _dirty.mark(from + i, 1);
+                }
+            }
+            from += n;
+            hsv += n;
+            count -= n;
         }
     }
     
-    uint32_t color(uint8_t h, uint8_t s, uint8_t v) { return Adafruit_NeoPixel::gamma32(Adafruit_NeoPixel::ColorHSV(uint16_t(h) * 256, s, v)); }
+    uint32_t color(uint8_t h, uint8_t s, uint8_t v) { return ColorConvert::hsvToColor(h, s, v); }
+
+    const DirtyTracker::Stats& stats() const { return _dirty.stats(); }
 
 private:
-    Adafruit_NeoPixel _pixels;
+    // Adafruit_NeoPixel always sends every pixel. This lets us send
+    // just the first count
+    class Strip : public Adafruit_NeoPixel
+    {
+    public:
+        Strip(uint16_t n, int16_t pin, neoPixelType type) : Adafruit_NeoPixel(n, pin, type) { }
+        
+        void show(uint16_t count)
+        {
+            uint16_t savedNumBytes = numBytes;
+            numBytes = count * 3;
+            Adafruit_NeoPixel::show();
+            numBytes = savedNumBytes;
+        }
+    };
+
+    bool setShadow(uint16_t i, uint8_t r, uint8_t g, uint8_t b)
+    {
+        uint8_t* p = _shadow + i * 3;
+        if (p[0] == r && p[1] == g && p[2] == b) {
+            return false;
+        }
+        p[0] = r;
+        p[1] = g;
+        p[2] = b;
+        return true;
+    }
+
+    Strip _pixels;
+    uint8_t* _shadow; // RGB, as set
+    DirtyTracker _dirty;
 };
 
 #elif defined ESP_PLATFORM
@@ -55,55 +157,155 @@ private:
 class NeoPixel
 {
 public:
-    NeoPixel(uint16_t numPixels, uint8_t ledPin) : _numPixels(numPixels) { }
+    NeoPixel(uint16_t numPixels, uint8_t, uint16_t pixelsPerPost = 0)
+        : _numPixels(numPixels)
+        , _dirty(pixelsPerPost ? pixelsPerPost : numPixels)
+    {
+        _dirty.mark(0, numPixels);
+    }
 
     void begin() { }
-    void setBrightness(uint8_t b) { }
+    void setBrightness(uint8_t) { }
     uint16_t numPixels() const { return _numPixels; }
-    void show() { }
+    
+    void show()
+    {
+        if (!_dirty.dirty()) {
+            _dirty.skipped();
+            return;
+        }
+        _dirty.refreshed(false);
+        _dirty.clear();
+    }
     
     void setLight(uint16_t i, uint32_t color)
     {
         printf("setLight(%d, 0x%08x)\n", i, (unsigned int) color);
+        _dirty.mark(i, 1);
     }
 
     void setLights(uint16_t from, uint16_t count, uint32_t color)
     {
         printf("setLights(%d, %d, 0x%08x)\n", from, count, (unsigned int) color);
+        _dirty.mark(from, count);
     }
 
-    uint32_t color(uint8_t h, uint8_t s, uint8_t v) { return (uint32_t(h) << 16) | (uint32_t(s) << 8) | uint32_t(v); }
+    void setLightsHSV(uint16_t from, const ColorConvert::HSV* hsv, uint16_t count)
+    {
+        for (uint16_t i = 0; i < count; ++i) {
+            setLight(from + i, color(hsv[i].h, hsv[i].s, hsv[i].v));
+        }
+    }
+
+    uint32_t color(uint8_t h, uint8_t s, uint8_t v) { return ColorConvert::hsvToColor(h, s, v); }
+
+    const DirtyTracker::Stats& stats() const { return _dirty.stats(); }
 
   private:
     uint16_t _numPixels = 0;
+    DirtyTracker _dirty;
 };
 
 #else
 
+// Host build. Keeps the pixels (RGB) and records each frame shown to a
+// FrameTrace. That's a RAM ring of DefaultTraceFrames unless traceTo()
+// gives it a file. Use linux/tracetool to decode or summarize the file.
 class NeoPixel
 {
 public:
-    NeoPixel(uint16_t numPixels, uint8_t ledPin) : _numPixels(numPixels) { }
+    static constexpr uint32_t DefaultTraceFrames = 1024;
+
+    NeoPixel(uint16_t numPixels, uint8_t, uint16_t pixelsPerPost = 0)
+        : _numPixels(numPixels)
+        , _pixels(new uint8_t[numPixels * 3]())
+        , _dirty(pixelsPerPost ? pixelsPerPost : numPixels)
+        , _start(std::chrono::steady_clock::now())
+    {
+        _dirty.mark(0, numPixels);
+        _trace.create(numPixels, DefaultTraceFrames);
+    }
 
     void begin() { }
-    void setBrightness(uint8_t b) { }
+    void setBrightness(uint8_t) { }
     uint16_t numPixels() const { return _numPixels; }
-    void show() { }
+    
+    // Record into a file rather than RAM. Returns false if it can't be made
+    bool traceTo(const char* path, uint32_t frames) { return _trace.create(_numPixels, frames, path); }
+
+    const FrameTrace& trace() const { return _trace; }
+    const uint8_t* pixels() const { return _pixels.get(); }
+
+    void show()
+    {
+        if (!_dirty.dirty()) {
+            _dirty.skipped();
+            return;
+        }
+        
+        uint64_t time = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start).count());
+        _trace.append(time, _pixels.get(), _dirty.first(), _dirty.last() - _dirty.first() + 1);
+        _dirty.refreshed(false);
+        _dirty.clear();
+    }
     
     void setLight(uint16_t i, uint32_t color)
     {
-        printf("setLight(%d, 0x%08x)\n", i, color);
+        if (i < _numPixels && setPixel(&_pixels[i * 3], uint8_t(color >> 16), uint8_t(color >> 8), uint8_t(color))) {
+            _dirty.mark(i, 1);
+        }
     }
 
     void setLights(uint16_t from, uint16_t count, uint32_t color)
     {
-        printf("setLights(%d, %d, 0x%08x)\n", from, count, color);
+        for (uint16_t i = 0; i < count; ++i) {
+            setLight(from + i, color);
+        }
     }
 
-    uint32_t color(uint8_t h, uint8_t s, uint8_t v) { return (uint32_t(h) << 16) | (uint32_t(s) << 8) | uint32_t(v); }
+    void setLightsHSV(uint16_t from, const ColorConvert::HSV* hsv, uint16_t count)
+    {
+        static constexpr uint16_t ChunkSize = 8;
+        uint8_t rgb[ChunkSize * 3];
+        
+        while (count > 0 && from < _numPixels) {
+            uint16_t n = (count < ChunkSize) ? count : ChunkSize;
+            if (n > _numPixels - from) {
+                n = _numPixels - from;
+            }
+            ColorConvert::hsvToPixels(hsv, rgb, n);
+            for (uint16_t i = 0; i < n; ++i) {
+                if (setPixel(&_pixels[(from + i) * 3], rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2])) {
+                    _dirty.mark(from + i, 1);
+                }
+            }
+            from += n;
+            hsv += n;
+            count -= n;
+        }
+    }
+
+    uint32_t color(uint8_t h, uint8_t s, uint8_t v) { return ColorConvert::hsvToColor(h, s, v); }
+
+    const DirtyTracker::Stats& stats() const { return _dirty.stats(); }
 
   private:
+    static bool setPixel(uint8_t* p, uint8_t r, uint8_t g, uint8_t b)
+    {
+        if (p[0] == r && p[1] == g && p[2] == b) {
+            return false;
+        }
+        p[0] = r;
+        p[1] = g;
+        p[2] = b;
+        return true;
+    }
+
     uint16_t _numPixels = 0;
+    std::unique_ptr<uint8_t[]> _pixels;
+    DirtyTracker _dirty;
+    FrameTrace _trace;
+    std::chrono::steady_clock::time_point _start;
 };
 
 #endif
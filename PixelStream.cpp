@@ -0,0 +1,280 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "PixelStream.h"
+
+#include "FrameBuffer.h"
+#include "FrameClock.h"
+#include "System.h"
+
+#include <chrono>
+
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static const char* TAG = "PixelStream";
+
+static constexpr size_t HeaderSize = 10;
+static constexpr size_t TimecodeSize = 4;
+
+static constexpr uint8_t VersionMask = 0xc0;
+static constexpr uint8_t Version1 = 0x40;
+static constexpr uint8_t Timecode = 0x10;
+static constexpr uint8_t Storage = 0x08;
+static constexpr uint8_t Reply = 0x04;
+static constexpr uint8_t Query = 0x02;
+static constexpr uint8_t Push = 0x01;
+
+static constexpr uint8_t SequenceMask = 0x0f;
+static constexpr uint8_t NumSequences = 15;
+
+// Data types which are RGB, 8 bits per channel. Senders use both the old
+// and new encodings, or leave it undefined
+static constexpr uint8_t TypeUndefined = 0x00;
+static constexpr uint8_t TypeRGB = 0x01;
+static constexpr uint8_t TypeRGB8 = 0x0b;
+
+static constexpr uint8_t DisplayId = 1;
+static constexpr uint8_t AllId = 255;
+
+bool
+PixelStream::begin(uint16_t port)
+{
+    end();
+
+    _socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (_socket < 0) {
+        mil::System::logE(TAG, "Can't create socket");
+        return false;
+    }
+
+    sockaddr_in addr = { };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        mil::System::logE(TAG, "Can't bind port %d", int(port));
+        end();
+        return false;
+    }
+
+    _listening = true;
+    _listener = std::thread([this]() { listen(); });
+
+    mil::System::logI(TAG, "Listening on port %d", int(port));
+    return true;
+}
+
+void
+PixelStream::end()
+{
+    if (_listener.joinable()) {
+        _listening = false;
+        _listener.join();
+    }
+    if (_socket >= 0) {
+        close(_socket);
+        _socket = -1;
+    }
+    _ready = false;
+    _streaming = false;
+}
+
+void
+PixelStream::listen()
+{
+    while (_listening) {
+        // Wait for loop() to take what's there before looking again
+        if (_ready) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // Wake up now and then to see if it's time to stop
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(_socket, &fds);
+        timeval timeout = { 0, 100000 };
+        if (select(_socket + 1, &fds, nullptr, nullptr, &timeout) > 0) {
+            _ready = true;
+            _frameClock->wake();
+        }
+    }
+}
+
+PixelStream::State
+PixelStream::loop(FrameBuffer& frameBuffer)
+{
+    uint32_t now = mil::System::millis();
+
+    if (_ready) {
+        // Clear it first. Anything arriving while we're reading is either
+        // read here or sets it again
+        _ready = false;
+
+        for (Packet packet = receive(frameBuffer); packet != Packet::None; packet = receive(frameBuffer)) {
+            if (packet == Packet::Waiting) {
+                // Let the caller get ready, then read it
+                _streaming = true;
+                _lastSeq = 0;
+                _lastPacket = now;
+                _ready = true;
+                return State::Started;
+            }
+
+            if (packet != Packet::Ignored) {
+                _lastPacket = now;
+            }
+            
+            // Show the frame before reading any more, which would be the
+            // next one's pixels. Whatever's left is read at the next frame,
+            // which starts straight away
+            if (packet == Packet::Pushed) {
+                _stats.frames++;
+                frameBuffer.show();
+                _ready = true;
+                _frameClock->wake();
+                break;
+            }
+        }
+    }
+
+    if (!_streaming) {
+        return State::Idle;
+    }
+
+    if (int32_t(now - _lastPacket) >= int32_t(Timeout)) {
+        _streaming = false;
+        _stats.timeouts++;
+        return State::TimedOut;
+    }
+    return State::Streaming;
+}
+
+PixelStream::Packet
+PixelStream::receive(FrameBuffer& frameBuffer)
+{
+    // Look at the header first to see where the data goes
+    uint8_t header[HeaderSize + TimecodeSize];
+    ssize_t size = recv(_socket, header, sizeof(header), MSG_PEEK | MSG_DONTWAIT);
+    if (size < 0) {
+        return Packet::None;
+    }
+
+    uint8_t flags = header[0];
+    size_t headerSize = (flags & Timecode) ? HeaderSize + TimecodeSize : HeaderSize;
+    bool valid = size_t(size) >= headerSize
+              && (flags & VersionMask) == Version1
+              && (flags & (Storage | Reply | Query)) == 0
+              && (header[2] == TypeUndefined || header[2] == TypeRGB || header[2] == TypeRGB8)
+              && (header[3] == DisplayId || header[3] == 0 || header[3] == AllId);
+
+    // Read just the header of packets we don't want, which throws away the rest
+    if (!valid) {
+        recv(_socket, header, 1, MSG_DONTWAIT);
+        _stats.ignored++;
+        return Packet::Ignored;
+    }
+
+    if (!_streaming) {
+        return Packet::Waiting;
+    }
+
+    _stats.packets++;
+    if (!checkSequence(header[1] & SequenceMask)) {
+        recv(_socket, header, 1, MSG_DONTWAIT);
+        return Packet::Read;
+    }
+
+    // The header goes in header and the data straight into the pixels.
+    // Anything past the end of the frame is thrown away
+    uint32_t offset = (uint32_t(header[4]) << 24) | (uint32_t(header[5]) << 16) | (uint32_t(header[6]) << 8) | header[7];
+    uint32_t length = (uint32_t(header[8]) << 8) | header[9];
+    uint32_t frameSize = uint32_t(frameBuffer.numPixels()) * 3;
+    if (offset >= frameSize) {
+        length = 0;
+    } else if (length > frameSize - offset) {
+        length = frameSize - offset;
+    }
+
+    iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = headerSize;
+    iov[1].iov_base = frameBuffer.streamPixels() + offset;
+    iov[1].iov_len = length;
+
+    msghdr msg = { };
+    msg.msg_iov = iov;
+    msg.msg_iovlen = length ? 2 : 1;
+    size = recvmsg(_socket, &msg, MSG_DONTWAIT);
+    if (size < ssize_t(headerSize)) {
+        return Packet::Read;
+    }
+
+    // A short packet only has some of its data
+    uint32_t received = uint32_t(size) - uint32_t(headerSize);
+    if (received > length) {
+        received = length;
+    }
+    if (received) {
+        uint16_t from = uint16_t(offset / 3);
+        uint16_t to = uint16_t((offset + received + 2) / 3);
+        frameBuffer.streamed(from, to - from);
+    }
+
+    return (flags & Push) ? Packet::Pushed : Packet::Read;
+}
+
+bool
+PixelStream::checkSequence(uint8_t seq)
+{
+    // 0 means the sender doesn't number its packets
+    if (seq == 0 || _lastSeq == 0) {
+        _lastSeq = seq;
+        return true;
+    }
+
+    // Sequence numbers go from 1 to 15, so they're compared around the
+    // circle. Up to half way round is ahead, anything else is behind
+    uint8_t ahead = uint8_t((seq + NumSequences - _lastSeq) % NumSequences);
+    if (ahead == 0 || ahead > NumSequences / 2) {
+        // A late packet was counted as dropped when the one after it came
+        _stats.late++;
+        if (ahead != 0 && _stats.dropped) {
+            _stats.dropped--;
+        }
+        return false;
+    }
+
+    _stats.dropped += ahead - 1;
+    _lastSeq = seq;
+    return true;
+}
+
+int32_t
+PixelStream::remaining() const
+{
+    int32_t remaining = int32_t(Timeout) - int32_t(mil::System::millis() - _lastPacket);
+    return (remaining > 0) ? remaining : 1;
+}
+
+std::string
+PixelStream::statsString() const
+{
+    return std::string("stream ") + (_streaming ? "on" : "off")
+         + " packets=" + std::to_string(_stats.packets)
+         + " frames=" + std::to_string(_stats.frames)
+         + " dropped=" + std::to_string(_stats.dropped)
+         + " late=" + std::to_string(_stats.late)
+         + " ignored=" + std::to_string(_stats.ignored)
+         + " timeouts=" + std::to_string(_stats.timeouts);
+}
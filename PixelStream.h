@@ -0,0 +1,111 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// PixelStream Class
+//
+// Receives frames from a host over UDP in DDP (Distributed Display
+// Protocol), which xLights, LedFx, WLED and others send. Each packet
+// carries a 10 byte header and the RGB bytes for part of the frame:
+//
+//      flags       0x40 version 1, 0x10 timecode follows the header,
+//                  0x01 push (show the frame)
+//      sequence    low 4 bits, 1 to 15 and around again. 0 isn't used
+//      data type   0 or RGB with 8 bits per channel
+//      id          1 is the display, 0 and 255 also accepted
+//      offset      32 bits, big endian. Byte offset into the frame
+//      length      16 bits, big endian. Bytes of data
+//
+// Data is received straight into the FrameBuffer's pixels, so nothing is
+// copied on the way. A frame can take several packets and is shown when
+// the one with the push flag arrives. Reading stops there until the next
+// loop(), so a frame's pixels are never overwritten by the next one's
+// before they're shown.
+//
+// Sequence numbers show which packets went missing. Those are counted as
+// dropped. A packet which arrives after a later one is counted as late
+// rather than dropped and thrown away, so it can't overwrite newer
+// pixels. Query, reply and storage packets are ignored.
+//
+// A thread waits for packets and wakes the FrameClock when they come, so
+// the frame loop picks them up without polling. When no stream is coming
+// the loop only checks a flag.
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+class FrameBuffer;
+class FrameClock;
+
+class PixelStream
+{
+public:
+    static constexpr uint16_t DefaultPort = 4048;
+    static constexpr uint32_t Timeout = 2500; // ms without packets before the stream ends
+
+    struct Stats
+    {
+        uint32_t packets = 0;
+        uint32_t frames = 0; // shown
+        uint32_t dropped = 0;
+        uint32_t late = 0;
+        uint32_t ignored = 0; // not for us or not pixel data
+        uint32_t timeouts = 0;
+    };
+
+    enum class State { Idle, Started, Streaming, TimedOut };
+
+    PixelStream(FrameClock* frameClock) : _frameClock(frameClock) { }
+    ~PixelStream() { end(); }
+
+    bool begin(uint16_t port = DefaultPort);
+    void end();
+
+    // Receive whatever has arrived into frameBuffer and show it if a frame
+    // was pushed. Started is returned for the first packets after Idle,
+    // before anything is written, so the caller can stop its effect.
+    // TimedOut is returned once when packets stop, after which it's Idle
+    State loop(FrameBuffer&);
+
+    // Stop streaming, e.g., when a command starts an effect. The next
+    // packet starts it again
+    void stop() { _streaming = false; }
+
+    bool streaming() const { return _streaming; }
+
+    // ms until the stream times out, while streaming
+    int32_t remaining() const;
+
+    const Stats& stats() const { return _stats; }
+    std::string statsString() const;
+
+private:
+    // What receive() did with the next packet. Waiting means it's a frame
+    // packet but we're not streaming yet, so it was left for later
+    enum class Packet { None, Ignored, Waiting, Read, Pushed };
+
+    void listen();
+    Packet receive(FrameBuffer&);
+    bool checkSequence(uint8_t seq);
+
+    FrameClock* _frameClock;
+    int _socket = -1;
+    std::thread _listener;
+    std::atomic<bool> _listening { false };
+    std::atomic<bool> _ready { false };
+
+    bool _streaming = false;
+    uint32_t _lastPacket = 0;
+    uint8_t _lastSeq = 0;
+
+    Stats _stats;
+};
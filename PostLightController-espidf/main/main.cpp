@@ -27,6 +27,14 @@ where 'c' is t he command to execute (e.g., 'f' for flicker) and the paramaters
 to the command are in the comma separated numeric list that follows. Each
 number is 0 to 255 and can be decimal or hex if preceded by '0x'.
 
+Several commands can be sent at once to the /commands URI:
+
+    http://.../commands?cmds=1-3:C,0,255,128,0,0;4-7:f,30,255,200,3&at=500
+
+Commands are separated by ';' and can be preceded by the posts they apply to.
+They are all applied at the start of the same frame, 'at' ms from now (optional).
+See CommandBatch.h.
+
 Command List:
 
    Command 	Name         	    Params						Description
@@ -35,6 +43,13 @@ Command List:
                                                             Flash n times, for d duration (in 100ms units)
                                                             If n == 0, just turn lights on
 
+    'f'     Flicker             color, speed                Native. Single color flickers randomly (speed 0-7)
+    'p'     Pulse               color, speed                Native. Single color pulses dim and bright (speed 0-7)
+    'm'     Multicolor          color x 4, speed            Native. Cross fade between 4 colors every speed seconds
+    'r'     Rainbow             color, speed, range         Native. Cycle hue from color (speed 0-15, range 0-7)
+
+    Native commands run in C++. All other commands are run by a Lua script of the same name.
+
     All other commands are a single lower case letter followed by as many params are needed for the command.
     All commands take at least one color param which is 3 consecutive bytes (hue, saturation, value). 
     Saturation and value are levels between 0 and 255. Hue is an angle on the color wheel. A 0-360 degree 
@@ -53,7 +68,9 @@ extern "C" {
 void app_main(void)
 {
     mil::System::logI(TAG, "Starting PostLightController...");
-    PostLightController controller(&portal);
+    
+    // Much too big for the stack, with its batches, clocks and effects
+    static PostLightController controller(&portal);
     controller.setup();
 
     while (true) {
@@ -9,88 +9,323 @@
 
 #include "PostLightController.h"
 
+#include "ColorConvert.h"
+#include "NativeEffect.h"
+
+#include <cstdio>
+#include <cstdlib>
+
 static const char* TAG = "PostLightController";
 
-static constexpr uint16_t MaxCmdSize = 16;
+static constexpr uint16_t MaxCmdSize = CommandBatch::MaxCmdSize;
 static constexpr int32_t MaxDelay = 1000; // ms
 static constexpr int32_t IdleDelay = 100; // ms
 
+// With a shared clock, effects start at the beginning of a SyncPeriod and
+// catch up with up to MaxCatchUp steps a frame
+static constexpr uint32_t SyncPeriod = 1000; // ms
+static constexpr uint8_t MaxCatchUp = 64;
+
+// Crossfade from the last streamed frame back to the effect
+static constexpr uint32_t StreamEndFade = 500; // ms
+
+// One instance of each native effect
+static NativeEffects nativeEffects;
+
 PostLightController::PostLightController(mil::WiFiPortal* portal)
     : mil::Application(portal, ConfigPortalName, true)
+    , _frameBuffer(_topology)
+    , _flash(&_frameBuffer)
+    , _luaEffect(&_frameBuffer)
+#ifdef PLC_CLOVER
+    , _cloverEffect(&_frameBuffer, CodeProvider::getCodeByte, &_code)
+#endif
+    , _transition(&_frameBuffer)
+    , _stream(&_frameClock)
+    , _preview(&_frameClock)
 {
-    mil::System::initLED(1, PixelPin, PixelsPerPost * NumPosts);
+    NativeEffect::seed(mil::System::millis());
 }
 
-static int16_t parseCmd(const std::string& cmd, uint8_t* buf, uint16_t size)
+void
+PostLightController::configure()
 {
-    // Cmd form is: <cmd char>,<param0 (0-255)>,<param1 (0-255)>,...<paramN (0-255)>
-    uint16_t strIndex = 0;
-    uint16_t bufIndex = 0;
-    bool parsingCmd = true;
+    // The default topology is already running. Switch if there's a valid config
+    if (_topology.load(TopologyPath)) {
+        _frameBuffer.configure(_topology);
+    } else {
+        mil::System::logI(TAG, "No valid %s, using the default topology", TopologyPath);
+    }
     
-    while (true) {
-        int16_t nextIndex = cmd.find(',', strIndex);
-        if (nextIndex == std::string::npos) {
-            // HACK ALERT: This is another case where string.length includes the terminating null on espidf!
-            nextIndex = strlen(cmd.c_str());
-        }
+    _memory.frameBuffer = _topology.numPixels() * 3;
+    _memory.nativeEffects = nativeEffects.configure(_topology);
+    _memory.luaEffect = _luaEffect.configure();
+    _memory.transition = _transition.configure();
+    
+#ifdef PLC_CLOVER
+    if (!_code.open(CloverPath)) {
+        mil::System::logI(TAG, "No %s, Clover effects are disabled", CloverPath);
+    }
+#endif
+    
+    // Followers and the master of a shared clock have a sync config
+    if (_syncClock.load(SyncPath)) {
+        _syncClock.begin();
+    }
+    _luaEffect.setClock(&_syncClock);
+    
+    mil::System::logI(TAG, "Topology %s, memory frameBuffer=%d nativeEffects=%d luaEffect=%d transition=%d",
+                      _topology.toString().c_str(), int(_memory.frameBuffer), int(_memory.nativeEffects),
+                      int(_memory.luaEffect), int(_memory.transition));
+}
 
-        if (parsingCmd) {
-            // Cmd must be a single char
-            if (nextIndex != 1) {
-                mil::System::logE(TAG, "parseCmd: cmd must be a single char at index %d", int(nextIndex));
-                return -1;
-            }
-            buf[bufIndex++] = uint8_t(cmd.c_str()[0]);
-            parsingCmd = false;
-        } else {
-            // Parse param. Must be 1 to 3 digits <= 255
-            uint16_t paramSize = nextIndex - strIndex;
-            if (paramSize < 1 || paramSize > 3) {
-                mil::System::logE(TAG, "parseCmd: param must be 1 to 3 chars at index %d", int(nextIndex));
-                return -1;
-            }
-            
-            uint16_t param = 0;
-            for (uint16_t i = 0; i < paramSize; ++i) {
-                uint16_t digit = uint16_t(cmd.c_str()[strIndex + i]) - '0';
-                if (digit > 9) {
-                    mil::System::logE(TAG, "parseCmd: digit out of range at index %d", int(nextIndex));
-                    return -1;
-                }
-                
-                param = param * 10 + digit;
+void
+PostLightController::processCommand(const std::string& cmd, uint32_t fade)
+{
+    mil::System::logI(TAG, "cmd='%s', fade=%d", cmd.c_str(), int(fade));
+    
+    // Start it at the next frame, like a batch of one, so the effects
+    // only ever change between frames
+    uint8_t buf[MaxCmdSize];
+    int16_t r = CommandBatch::parseCmd(cmd.c_str(), cmd.size(), buf, MaxCmdSize);
+    if (r >= 0) {
+        std::lock_guard<std::mutex> lock(_batchMutex);
+        _pendingBatch.set(buf, r, _topology.numPosts());
+        _batchTime = mil::System::millis();
+        _batchFade = fade;
+        _batchPending = true;
+    }
+    
+    // Don't wait out the rest of the current frame to start the new effect
+    _frameClock.wake();
+    
+    _portal->sendHTTPResponse(200, "text/plain", "command processed");
+}
+
+void
+PostLightController::processBatch(const std::string& cmds, uint32_t startDelay, uint32_t fade)
+{
+    mil::System::logI(TAG, "batch='%s', at=%d, fade=%d", cmds.c_str(), int(startDelay), int(fade));
+    
+    // loop() takes the pending batch under the lock, so it never sees one
+    // half parsed
+    std::unique_lock<std::mutex> lock(_batchMutex);
+    queueBatch(lock, _pendingBatch.parse(cmds, _topology.numPosts()), startDelay, fade);
+}
+
+void
+PostLightController::processBinary(const std::string& body, uint32_t fade)
+{
+    std::unique_lock<std::mutex> lock(_batchMutex);
+    queueBatch(lock, _pendingBatch.parseBinary(reinterpret_cast<const uint8_t*>(body.data()), body.size(), _topology.numPosts()), 0, fade);
+}
+
+void
+PostLightController::queueBatch(std::unique_lock<std::mutex>& lock, bool parsed, uint32_t startDelay, uint32_t fade)
+{
+    if (!parsed || !checkBatch(_pendingBatch)) {
+        _pendingBatch.clear();
+        _batchPending = false;
+        lock.unlock();
+        _portal->sendHTTPResponse(400, "text/plain", "invalid batch");
+        return;
+    }
+    
+    _batchTime = mil::System::millis() + startDelay;
+    _batchFade = fade;
+    _batchPending = true;
+    lock.unlock();
+    _frameClock.wake();
+    
+    _portal->sendHTTPResponse(200, "text/plain", "batch accepted");
+}
+
+bool
+PostLightController::checkBatch(const CommandBatch& batch) const
+{
+    // A single command for all posts can be anything sendCmd accepts
+    if (batch.size() == 1 && batch[0].numPosts == _topology.numPosts()) {
+        return true;
+    }
+    
+    // Otherwise each command runs on its own posts. Constant colors
+    // are painted once and can't flash. Anything else must be a native
+    // effect (Lua scripts always drive every post) and each native
+    // effect can only be used once since there's one of each.
+    uint8_t layers = 0;
+    for (uint8_t i = 0; i < batch.size(); ++i) {
+        const CommandBatch::Command& cmd = batch[i];
+        if (cmd.buf[0] == 'C') {
+            if (cmd.size > 4 && cmd.buf[4] != 0) {
+                mil::System::logE(TAG, "batch: 'C' can't flash in a batch");
+                return false;
             }
-            
-            if (param > 255) {
-                param = 255;
+            continue;
+        }
+        
+        if (!nativeEffects.find(cmd.buf[0])) {
+            mil::System::logE(TAG, "batch: '%c' is not a native effect", char(cmd.buf[0]));
+            return false;
+        }
+        
+        for (uint8_t j = 0; j < i; ++j) {
+            if (batch[j].buf[0] == cmd.buf[0]) {
+                mil::System::logE(TAG, "batch: '%c' used more than once", char(cmd.buf[0]));
+                return false;
             }
-            
-            buf[bufIndex++] = uint8_t(param);
         }
-        strIndex = nextIndex;
-        if (cmd[strIndex] == ',') {
-            strIndex += 1;
+        
+        if (++layers > MaxLayers) {
+            mil::System::logE(TAG, "batch: more than %d effects", int(MaxLayers));
+            return false;
         }
+    }
+    return true;
+}
+
+bool
+PostLightController::takeBatch()
+{
+    std::lock_guard<std::mutex> lock(_batchMutex);
+    if (!_batchPending || int32_t(mil::System::millis() - _batchTime) < 0) {
+        return false;
+    }
+    
+    _batch = _pendingBatch;
+    _fade = _batchFade;
+    _batchPending = false;
+    return true;
+}
+
+int32_t
+PostLightController::untilBatch()
+{
+    std::lock_guard<std::mutex> lock(_batchMutex);
+    return _batchPending ? int32_t(_batchTime - mil::System::millis()) : INT32_MAX;
+}
+
+void
+PostLightController::applyBatch()
+{
+    _lastBatch = _batch;
+    
+    if (_batch.size() == 1 && _batch[0].numPosts == _topology.numPosts()) {
+        sendCmd(_batch[0].buf, _batch[0].size, _fade);
+        _batch.clear();
+        return;
+    }
+    
+    // Start each command on its posts, on a cleared FrameBuffer
+    stopEffect();
+    _transition.start(_fade);
+    uint32_t start = startEffects();
+    
+    for (uint8_t i = 0; i < _batch.size(); ++i) {
+        const CommandBatch::Command& cmd = _batch[i];
+        uint16_t from = cmd.firstPost * _topology.pixelsPerPost();
+        uint16_t count = cmd.numPosts * _topology.pixelsPerPost();
         
-        if (cmd[strIndex] == '\0') {
-            return bufIndex;
+        if (cmd.buf[0] == 'C') {
+            uint8_t r, g, b;
+            ColorConvert::hsvToRGB(cmd.buf[1], cmd.buf[2], cmd.buf[3], r, g, b);
+            _frameBuffer.setLights(from, count, r, g, b);
+        } else if (addLayer(nativeEffects.find(cmd.buf[0]), cmd.buf, cmd.size, cmd.firstPost, cmd.numPosts, start)) {
+            _effect = Effect::Native;
         }
     }
+    
+    // The transition shows it, at the first step of a fade
+    _batch.clear();
 }
 
 void
-PostLightController::processCommand(const std::string& cmd)
+PostLightController::endStream()
 {
-    mil::System::logI(TAG, "cmd='%s'", cmd.c_str());
+    // Go back to the effect which was running, unless a new one is on its way
+    if (_batchPending) {
+        return;
+    }
     
-    uint8_t buf[MaxCmdSize];
-    int16_t r = parseCmd(cmd, buf, MaxCmdSize);
-    if (r >= 0) {
-        sendCmd(buf, r);
+    if (_lastBatch.size() == 0) {
+        showColor(0, 0, 0, 0, 0);
+        return;
     }
     
-    _portal->sendHTTPResponse(200, "text/plain", "command processed");
+    _batch = _lastBatch;
+    _fade = StreamEndFade;
+    applyBatch();
+}
+
+uint32_t
+PostLightController::startEffects()
+{
+    // Controllers sharing a clock start at the same time with the same
+    // random numbers, so the same command sent to each within the same
+    // SyncPeriod draws the same frames. Otherwise effects start now
+    uint32_t now = _syncClock.millis();
+    if (!_syncClock.synced()) {
+        return now;
+    }
+    
+    uint32_t start = now - now % SyncPeriod;
+    NativeEffect::seed(start);
+    return start;
+}
+
+bool
+PostLightController::addLayer(NativeEffect* effect, const uint8_t* cmd, uint16_t size, uint16_t firstPost, uint16_t numPosts, uint32_t start)
+{
+    if (_numLayers >= MaxLayers) {
+        return false;
+    }
+    
+    _frameBuffer.setWindow(firstPost * _topology.pixelsPerPost(), numPosts * _topology.pixelsPerPost());
+    bool result = effect->init(&_frameBuffer, cmd + 1, size - 1);
+    _frameBuffer.clearWindow();
+    
+    if (!result) {
+        return false;
+    }
+    
+    _layers[_numLayers++] = { effect, firstPost, numPosts, start };
+    return true;
+}
+
+int32_t
+PostLightController::runLayers()
+{
+    uint32_t now = _syncClock.millis();
+    int32_t delayInMs = MaxDelay;
+    
+    // With a shared clock each step is due a fixed time after the last
+    // one, from when the layer started, and any missed are caught up.
+    // Every controller is then on the same step at the same time.
+    // Otherwise the next step is timed from now
+    bool synced = _syncClock.synced();
+    
+    for (uint8_t i = 0; i < _numLayers; ++i) {
+        Layer& layer = _layers[i];
+        
+        for (uint8_t steps = 0; int32_t(now - layer.due) >= 0 && steps < (synced ? MaxCatchUp : 1); ++steps) {
+            _frameBuffer.setWindow(layer.firstPost * _topology.pixelsPerPost(), layer.numPosts * _topology.pixelsPerPost());
+            int32_t d = layer.effect->loop();
+            layer.due = (synced ? layer.due : now) + ((d > 0) ? d : IdleDelay);
+        }
+        
+        // Too far behind to catch up, e.g., after the clock first locks
+        if (synced && int32_t(now - layer.due) >= 0) {
+            layer.due = now;
+        }
+        
+        int32_t remaining = int32_t(layer.due - now);
+        if (remaining < delayInMs) {
+            delayInMs = remaining;
+        }
+    }
+    
+    _frameBuffer.clearWindow();
+    _frameBuffer.show();
+    return (delayInMs > 0) ? delayInMs : 1;
 }
 
 void
@@ -102,32 +337,113 @@ PostLightController::setup()
 
     Application::setup();
     
+    // Load the topology once the file system is up
+    configure();
+    
     // Just in case
     _effect = Effect::None;
     _effectId = -1;
 
     setTitle((std::string("<center>MarrinTech Post Light Controller v") + Version + "</center>").c_str());
 
-    addHTTPHandler("/command", [this](mil::WiFiPortal* p)
+    addHTTPHandler("/command", [this](mil::WiFiPortal*)
+    {
+        processCommand(_portal->getHTTPArg("cmd"), fadeArg());
+        return true;
+    });
+
+    // Body (or arg) 'cmds' is a ';' separated list of commands. See CommandBatch.h.
+    // Optional 'at' is the number of ms from now to apply them
+    addHTTPHandler("/commands", [this](mil::WiFiPortal*)
+    {
+        std::string at = _portal->getHTTPArg("at");
+        processBatch(_portal->getHTTPArg("cmds"), at.empty() ? 0 : uint32_t(atol(at.c_str())), fadeArg());
+        return true;
+    });
+
+    // Body is the binary form of a batch. See CommandBatch.h. The portal
+    // copies the body by its length (which is why it has the extra null on
+    // espidf), so 0 bytes in it are kept
+    addHTTPHandler("/binary", [this](mil::WiFiPortal*)
+    {
+        processBinary(_portal->getHTTPArg("plain"), fadeArg());
+        return true;
+    });
+
+    addHTTPHandler("/stats", [this](mil::WiFiPortal*)
     {
-        processCommand(_portal->getHTTPArg("cmd"));
+        std::string stats = _frameClock.statsString() + "\n" + _frameBuffer.statsString() + "\n" + _luaEffect.statsString()
+                          + "\n" + _syncClock.statsString() + "\n" + _stream.statsString()
+                          + "\n" + _preview.statsString()
+#ifdef PLC_CLOVER
+                          + "\nclover " + _cloverEffect.statsString() + " " + _code.statsString()
+#endif
+                          + "\ntopology " + _topology.toString()
+                          + "\nmemory frameBuffer=" + std::to_string(_memory.frameBuffer)
+                          + " nativeEffects=" + std::to_string(_memory.nativeEffects)
+                          + " luaEffect=" + std::to_string(_memory.luaEffect)
+                          + " transition=" + std::to_string(_memory.transition);
+        _portal->sendHTTPResponse(200, "text/plain", stats.c_str());
         return true;
     });
 
+    // Hosts can stream frames to us (see PixelStream.h)
+    _stream.begin();
+    
+    // Browsers can watch the lights (see LivePreview.h)
+    _preview.begin(_topology.numPosts(), _topology.pixelsPerPost());
+
     mil::System::logI(TAG, "Post Light Controller v%s", Version);
   
     showStatus(StatusColor::Green, 3, 2);
+    _frameClock.reset();
 }
 	
 void
 PostLightController::loop()
 {
     Application::loop();
+    _syncClock.loop();
+
+    // A batch is applied at the start of a frame, once its time comes
+    if (takeBatch()) {
+        applyBatch();
+    }
 
+    // Pixels streamed from a host take over the lights until they stop
+    PixelStream::State streamState = _stream.loop(_frameBuffer);
+    if (streamState == PixelStream::State::Started) {
+        stopEffect();
+        _transition.finish();
+        _frameBuffer.clear();
+        _effect = Effect::Stream;
+        streamState = _stream.loop(_frameBuffer);
+    }
+    if (streamState == PixelStream::State::TimedOut) {
+        _effect = Effect::None;
+        endStream();
+    }
+    
+    // A transition from the last effect sets how far along its fade is
+    // before this one draws
+    bool transitioning = _transition.active();
+    int32_t step = _transition.loop();
+    uint32_t refreshes = _frameBuffer.stats().refreshes;
+    
     int32_t delayInMs = IdleDelay;
     
     if (_effect == Effect::Flash) {
         delayInMs = _flash.loop();
+    } else if (_effect == Effect::Native) {
+        delayInMs = runLayers();
+    } else if (_effect == Effect::Lua) {
+        delayInMs = _luaEffect.loop();
+#ifdef PLC_CLOVER
+    } else if (_effect == Effect::Clover) {
+        delayInMs = _cloverEffect.loop();
+#endif
+    } else if (_effect == Effect::Stream) {
+        delayInMs = _stream.remaining();
     }
     
     if (delayInMs > MaxDelay) {
@@ -142,34 +458,105 @@ PostLightController::loop()
         delayInMs = IdleDelay;
     }
     
-    mil::System::delay(delayInMs);
+    // 0 means the effect has nothing to do until the next command
+    if (delayInMs == 0) {
+        delayInMs = IdleDelay;
+    }
+    
+    // Show the transition's step if the effect didn't
+    if (transitioning) {
+        if (_frameBuffer.stats().refreshes == refreshes) {
+            _frameBuffer.show();
+        }
+        if (step > 0 && step < delayInMs) {
+            delayInMs = step;
+        }
+    }
+    
+    // Don't sleep past the start of a pending batch
+    int32_t batchDelay = untilBatch();
+    if (batchDelay < delayInMs) {
+        delayInMs = (batchDelay > 0) ? batchDelay : 0;
+    }
+    
+    // Clean up after Lua scripts which have finished, a bit each frame
+    _luaEffect.collectIdle();
+    
+    // Send what's on the lights to any browsers watching
+    _preview.loop(_frameBuffer);
+    
+    // Wait until the next frame deadline. This makes up for the time
+    // spent rendering this frame and returns early if a command arrives
+    _frameClock.wait(delayInMs);
 }
 
 bool
-PostLightController::sendCmd(const uint8_t* cmd, uint16_t size)
+PostLightController::sendCmd(const uint8_t* cmd, uint16_t size, uint32_t fade)
 {
     if (size < 1) {
         return false;
     }
     
-    // Send a command to turn off the pixels. This will also
-    // Kill any Lua programs running
-    showColor(0, 0, 0, 0, 0);
+    // Stop the running effect, but leave its frame on the lights until
+    // the new one replaces it or fades in over it
+    stopEffect();
+    _transition.start(fade);
+    uint32_t start = startEffects();
     
     if (cmd[0] == 'C') {
         // Built-in color command
-        showColor(cmd[1], cmd[2], cmd[3], cmd[4], cmd[5]);
         _effect = Effect::Flash;
+        _flash.init(cmd[1], cmd[2], cmd[3], cmd[4], cmd[5]);
         return true;
     }
 
-    _effect = Effect::Lua;
+    // Use the native implementation if there is one
+    NativeEffect* effect = nativeEffects.find(cmd[0]);
+    if (effect) {
+        if (!addLayer(effect, cmd, size, 0, _topology.numPosts(), start)) {
+            return false;
+        }
+        _effect = Effect::Native;
+        return true;
+    }
+
+    // Otherwise it's a Lua script. Run it ourselves if we can find it,
+    // which reuses its compiled code and a warm Lua state
+    char path[64];
+    snprintf(path, sizeof(path), "%s/%c.lua", ScriptDir, char(cmd[0]));
+    if (_luaEffect.init(path, cmd + 1, size - 1)) {
+        _effect = Effect::Lua;
+        return true;
+    }
     
-    // Make a command with args
-    std::string luaCmd = std::string(1, cmd[0]);
-    for (int i = 1; i < size; ++i) {
-        luaCmd += " " + std::to_string(cmd[i]);
+#ifdef PLC_CLOVER
+    // Then Clover, if its executable is there
+    if (_code.size() && _cloverEffect.init(cmd[0], cmd + 1, size - 1)) {
+        _effect = Effect::Clover;
+        return true;
+    }
+#endif
+    
+    // If not, have the shell run it. It sets the LEDs itself, so it starts from black
+    _transition.finish();
+    _frameBuffer.show();
+    _effect = Effect::Shell;
+    
+    // Make a command with args. Each arg is at most 4 chars (" 255")
+    char luaCmd[MaxCmdSize * 4 + 1];
+    char* p = luaCmd;
+    *p++ = char(cmd[0]);
+    for (int i = 1; i < size && i < MaxCmdSize; ++i) {
+        *p++ = ' ';
+        if (cmd[i] >= 100) {
+            *p++ = '0' + cmd[i] / 100;
+        }
+        if (cmd[i] >= 10) {
+            *p++ = '0' + (cmd[i] / 10) % 10;
+        }
+        *p++ = '0' + cmd[i] % 10;
     }
+    *p = '\0';
     _effectId = handleShellCommand(luaCmd);
     return true;
 }
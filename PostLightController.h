@@ -13,16 +13,45 @@
 #pragma once
 
 #include "Application.h"
+#include "CommandBatch.h"
 #include "Flash.h"
+#include "FrameBuffer.h"
+#include "FrameClock.h"
+#include "LivePreview.h"
+#include "LuaEffect.h"
+#include "PixelStream.h"
+#include "SyncClock.h"
+#include "Topology.h"
+#include "Transition.h"
+
+#ifdef PLC_CLOVER
+#include "CodeProvider.h"
+#include "InterpretedEffect.h"
+#endif
+
+#include <atomic>
+#include <mutex>
+
+class NativeEffect;
 
 static constexpr const char* ConfigPortalName = "MT PostLightController";
 static constexpr const char* Hostname = "plc";
 static constexpr const char* Version = "0.1";
 
-static constexpr int PixelsPerPost = 8;
-static constexpr int NumPosts = 7;
-static constexpr int PixelPin = 10;
-static constexpr int TotalPixels = PixelsPerPost * NumPosts;
+// Where Lua effect scripts (e.g., f.lua), the Clover executable, the
+// topology (see Topology.h) and the clock sync role (see SyncClock.h)
+// are found
+#ifdef ESP_PLATFORM
+static constexpr const char* ScriptDir = "/littlefs";
+static constexpr const char* CloverPath = "/littlefs/executable.clvx";
+static constexpr const char* TopologyPath = "/littlefs/topology.txt";
+static constexpr const char* SyncPath = "/littlefs/sync.txt";
+#else
+static constexpr const char* ScriptDir = "littlefs";
+static constexpr const char* CloverPath = "littlefs/executable.clvx";
+static constexpr const char* TopologyPath = "littlefs/topology.txt";
+static constexpr const char* SyncPath = "littlefs/sync.txt";
+#endif
 
 class PostLightController : public mil::Application
 {
@@ -32,20 +61,46 @@ class PostLightController : public mil::Application
     virtual void setup() override;
     virtual void loop() override;
     
-    bool sendCmd(const uint8_t* cmd, uint16_t size);
-    void processCommand(const std::string& cmd);
+    // fade is the ms to crossfade from the last effect (see Transition.h).
+    // With 0 the new effect replaces it at the next frame
+    bool sendCmd(const uint8_t* cmd, uint16_t size, uint32_t fade = 0);
+    void processCommand(const std::string& cmd, uint32_t fade = 0);
+    
+    // Apply a list of commands all at once, startDelay ms from now
+    void processBatch(const std::string& cmds, uint32_t startDelay, uint32_t fade = 0);
+    void processBinary(const std::string& body, uint32_t fade = 0);
+
+    const Topology& topology() const { return _topology; }
+
+#ifdef PLC_CLOVER
+    CodeProvider& codeProvider() { return _code; }
+#endif
 
   private:	
 	enum class StatusColor { Red, Green, Yellow, Blue };
 
-	void showColor(uint8_t h, uint8_t s, uint8_t v, uint8_t n, uint8_t d)
-	{
-        if (_effect == Effect::Lua && _effectId >= 0) {
+    // Stop the running effect, leaving its last frame on the lights
+    void stopEffect()
+    {
+        if (_effect == Effect::Shell && _effectId >= 0) {
             terminateShellCommand(_effectId);
-            _effect = Effect::None;
             _effectId = -1;
         }
+        if (_effect == Effect::Lua) {
+            _luaEffect.stop();
+        }
+        if (_effect == Effect::Stream) {
+            _stream.stop();
+        }
+
+        _numLayers = 0;
+        _effect = Effect::None;
+    }
 
+	void showColor(uint8_t h, uint8_t s, uint8_t v, uint8_t n, uint8_t d)
+	{
+        stopEffect();
+        _transition.finish();
         _effect = Effect::Flash;
         _flash.init(h, s, v, n, d);
 	}
@@ -64,8 +119,82 @@ class PostLightController : public mil::Application
         showColor(h, 0xff, 0x80, numberOfBlinks, interval);
 	}
  
-    enum class Effect { None, Flash, Lua };
+    void configure();
+    uint32_t fadeArg() const
+    {
+        std::string fade = _portal->getHTTPArg("fade");
+        return fade.empty() ? 0 : uint32_t(atol(fade.c_str()));
+    }
+    // Called by the HTTP handlers with _batchMutex held by lock
+    void queueBatch(std::unique_lock<std::mutex>& lock, bool parsed, uint32_t startDelay, uint32_t fade);
+    bool checkBatch(const CommandBatch&) const;
+    
+    // Move the pending batch to _batch if its time has come
+    bool takeBatch();
+    int32_t untilBatch();
+    void applyBatch();
+    void endStream();
+    uint32_t startEffects();
+    bool addLayer(NativeEffect*, const uint8_t* cmd, uint16_t size, uint16_t firstPost, uint16_t numPosts, uint32_t start);
+    int32_t runLayers();
+ 
+    // Lua scripts run in process (Lua) or, if that fails, as a shell command (Shell).
+    // Clover effects are run from CloverPath when the build has Clover.
+    // Stream is pixels sent from a host (see PixelStream.h)
+    enum class Effect { None, Flash, Native, Lua, Clover, Shell, Stream };
     Effect _effect = Effect::None;
+    Topology _topology;
+    FrameBuffer _frameBuffer;
 	Flash _flash;
+    LuaEffect _luaEffect;
+#ifdef PLC_CLOVER
+    CodeProvider _code;
+    InterpretedEffect _cloverEffect;
+#endif
+    Transition _transition;
     int8_t _effectId = -1;
+    FrameClock _frameClock;
+    SyncClock _syncClock;
+    PixelStream _stream;
+    LivePreview _preview;
+    
+    // Bytes allocated for the topology by each part
+    struct Memory
+    {
+        size_t frameBuffer = 0;
+        size_t nativeEffects = 0;
+        size_t luaEffect = 0;
+        size_t transition = 0;
+    };
+    Memory _memory;
+    
+    // Native effects run as layers, each on its own range of posts.
+    // A single command has one layer covering all posts
+    struct Layer
+    {
+        NativeEffect* effect;
+        uint16_t firstPost;
+        uint16_t numPosts;
+        uint32_t due; // ms, on the SyncClock
+    };
+    
+    static constexpr uint8_t MaxLayers = 4;
+    Layer _layers[MaxLayers];
+    uint8_t _numLayers = 0;
+    
+    // Filled in by processCommand and processBatch on the HTTP thread.
+    // loop() takes it into _batch under _batchMutex at the start of a
+    // frame, so the frame thread only ever applies its own copy
+    std::mutex _batchMutex;
+    CommandBatch _pendingBatch;
+    std::atomic<bool> _batchPending { false };
+    uint32_t _batchTime = 0;
+    uint32_t _batchFade = 0;
+    
+    // The batch being applied and its fade
+    CommandBatch _batch;
+    uint32_t _fade = 0;
+    
+    // The last batch applied, to go back to when a stream ends
+    CommandBatch _lastBatch;
 };
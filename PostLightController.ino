@@ -37,6 +37,36 @@ All characters but the payload and payload size are between 0x30 and 0x6f. Max p
 ending characters, truncating the result to 6 bits and adding 0x30 to the result. For purposes 
 of computing checksum, a '0' is placed in the checksum location.
 
+CRC Framing
+
+The additive checksum misses many errors, so a command can instead be sent with '[' as the
+lead-in and ']' as the lead-out. The checksum byte is then a CRC-8 (polynomial 0x07, initial
+value 0) of every byte from the lead-in through the last payload byte, and can be any value.
+Both framings are always accepted.
+
+Incremental Uploads
+
+Rather than sending the whole image with 'X', an uploader can send only the parts which have
+changed, with 'W'. The chain has no return path, so the uploader either keeps the hashes of
+what it last sent or gets them from a device's console with 'H', and then sends a 'W' for each
+64 byte page whose hash differs from the new image.
+
+Bit Rate Negotiation
+
+Devices start at 2400 baud. The 'B' command changes the rate. Each device forwards the 'B'
+command at the old rate and then switches, so the sender must wait for it to reach the end
+of the chain before sending at the new rate. When a device not at 2400 baud sees repeated
+errors (bad checksums, bad framing, timeouts or stray characters) it falls back to 2400 and
+sends a run of 0x00 characters downstream, which looks like errors to a device at a higher
+rate, so the fallback spreads down the chain. A sender can force the whole chain back to
+2400 the same way, and should resend 'B' after that, or whenever it gets no response.
+
+'B' must be sent to address '0'. Changing the rate of some devices would leave the rest of
+the chain unable to hear them, so a 'B' for a single device is ignored by it. The chain has no
+return path, so there's no acknowledgement on it. Each device prints the rate it's running at
+on its console ("Baud=") when it gets a 'B', even if that's unchanged, and a sender with no
+console to watch can send a command at the new rate and resend 'B' if nothing happens.
+
 To allow for interpreted commands each "normal" command (those which cause the lights to do a 
 pattern) are limited to 16 bytes. This is enough for 4 colors (12 bytes) plus 4 byte params. The only
 command which can exceed this is the 'X' command.
@@ -49,9 +79,24 @@ Command List:
                                                         Flash n times, for d duration (in 100ms units)
                                                         If n == 0, just turn lights on
 
+	'B'		Bit Rate		index						Change the bit rate. index is 0-4 for
+														2400, 4800, 9600, 19200 or 38400 baud. Does
+														not change the current effect. Broadcast
+														(address '0') only.
+
 	'X'		EEPROM[0]		addr, <data>				Write EEPROM starting at addr. Data can be
 														up to 64 bytes, due to buffering limitations.
 
+	'W'		Write Chunk		addr (2 bytes), <data>		Write data to EEPROM starting at addr (high
+														byte first). Bytes which are unchanged are not
+														written.
+
+	'H'		Page Hashes		page, count					Print the hash of count EEPROM pages starting
+														at page to the console, one "H page hash" line
+														per page. Pages are 64 bytes and the hash is
+														Fletcher-16 in hex. Does not change the current
+														effect.
+
 			Rainbow			color, speed, range, mode	Change color through the rainbow by changing hue 
 														from the passed color at the passed speed. Range
 														is how far from the passed color to go, 0 (very little)
@@ -77,9 +122,61 @@ constexpr int CommandSizeBefore = 5;
 constexpr int CommandSizeAfter = 2;
 constexpr char StartChar = '(';
 constexpr char EndChar = ')';
+constexpr char CRCStartChar = '[';
+constexpr char CRCEndChar = ']';
 constexpr unsigned long SerialTimeOut = 2000; // ms
 constexpr int32_t MaxDelay = 1000; // ms
 
+// When true, packets for other devices are forwarded a byte at a time as
+// they arrive, with the address and checksum fixed up on the fly, rather
+// than after the whole packet has been received and checked. Latency no
+// longer grows with the length of the chain. A bad packet is still
+// forwarded, but the next device will see the bad checksum and drop it.
+// Broadcast packets are executed here, so they have to fit and be checked
+// first. They're still forwarded after they've been received.
+//
+// SoftwareSerial can't receive while it's sending, so this requires the
+// sender to leave at least one character time between bytes. It's off
+// unless built with PLC_CUT_THROUGH set to 1, e.g.:
+//
+//      arduino-cli compile --build-property "compiler.cpp.extra_flags=-DPLC_CUT_THROUGH=1" ...
+//
+// Every device in the chain should be built the same way.
+#ifndef PLC_CUT_THROUGH
+#define PLC_CUT_THROUGH 0
+#endif
+constexpr bool CutThrough = PLC_CUT_THROUGH;
+
+constexpr uint16_t EEPROMPageSize = 64;
+
+constexpr long BaudRates[ ] = { 2400, 4800, 9600, 19200, 38400 };
+constexpr uint8_t NumBaudRates = sizeof(BaudRates) / sizeof(BaudRates[0]);
+constexpr uint8_t BaseBaudIndex = 0;
+constexpr uint8_t MaxLinkErrors = 8;
+constexpr char SyncChar = 0;
+constexpr uint8_t SyncLength = 16;
+
+// CRC-8, polynomial 0x07
+static const uint8_t CRCTable[256] PROGMEM =
+{
+    0x00, 0x07, 0x0e, 0x09, 0x1c, 0x1b, 0x12, 0x15, 0x38, 0x3f, 0x36, 0x31, 0x24, 0x23, 0x2a, 0x2d,
+    0x70, 0x77, 0x7e, 0x79, 0x6c, 0x6b, 0x62, 0x65, 0x48, 0x4f, 0x46, 0x41, 0x54, 0x53, 0x5a, 0x5d,
+    0xe0, 0xe7, 0xee, 0xe9, 0xfc, 0xfb, 0xf2, 0xf5, 0xd8, 0xdf, 0xd6, 0xd1, 0xc4, 0xc3, 0xca, 0xcd,
+    0x90, 0x97, 0x9e, 0x99, 0x8c, 0x8b, 0x82, 0x85, 0xa8, 0xaf, 0xa6, 0xa1, 0xb4, 0xb3, 0xba, 0xbd,
+    0xc7, 0xc0, 0xc9, 0xce, 0xdb, 0xdc, 0xd5, 0xd2, 0xff, 0xf8, 0xf1, 0xf6, 0xe3, 0xe4, 0xed, 0xea,
+    0xb7, 0xb0, 0xb9, 0xbe, 0xab, 0xac, 0xa5, 0xa2, 0x8f, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9d, 0x9a,
+    0x27, 0x20, 0x29, 0x2e, 0x3b, 0x3c, 0x35, 0x32, 0x1f, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0d, 0x0a,
+    0x57, 0x50, 0x59, 0x5e, 0x4b, 0x4c, 0x45, 0x42, 0x6f, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7d, 0x7a,
+    0x89, 0x8e, 0x87, 0x80, 0x95, 0x92, 0x9b, 0x9c, 0xb1, 0xb6, 0xbf, 0xb8, 0xad, 0xaa, 0xa3, 0xa4,
+    0xf9, 0xfe, 0xf7, 0xf0, 0xe5, 0xe2, 0xeb, 0xec, 0xc1, 0xc6, 0xcf, 0xc8, 0xdd, 0xda, 0xd3, 0xd4,
+    0x69, 0x6e, 0x67, 0x60, 0x75, 0x72, 0x7b, 0x7c, 0x51, 0x56, 0x5f, 0x58, 0x4d, 0x4a, 0x43, 0x44,
+    0x19, 0x1e, 0x17, 0x10, 0x05, 0x02, 0x0b, 0x0c, 0x21, 0x26, 0x2f, 0x28, 0x3d, 0x3a, 0x33, 0x34,
+    0x4e, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5c, 0x5b, 0x76, 0x71, 0x78, 0x7f, 0x6a, 0x6d, 0x64, 0x63,
+    0x3e, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2c, 0x2b, 0x06, 0x01, 0x08, 0x0f, 0x1a, 0x1d, 0x14, 0x13,
+    0xae, 0xa9, 0xa0, 0xa7, 0xb2, 0xb5, 0xbc, 0xbb, 0x96, 0x91, 0x98, 0x9f, 0x8a, 0x8d, 0x84, 0x83,
+    0xde, 0xd9, 0xd0, 0xd7, 0xc2, 0xc5, 0xcc, 0xcb, 0xe6, 0xe1, 0xe8, 0xef, 0xfa, 0xfd, 0xf4, 0xf3,
+};
+
 class PostLightController
 {
 public:
@@ -97,7 +194,7 @@ public:
 	{
 	    Serial.begin(115200);
         while (!Serial) ; // wait for Arduino Serial Monitor to open
-	    _serial.begin(2400);
+	    _serial.begin(BaudRates[BaseBaudIndex]);
 		
 		delay(500);
 
@@ -112,6 +209,33 @@ public:
 
 	void loop()
 	{
+		// Drain everything SoftwareSerial has buffered. Its RX interrupt fills
+		// a small ring buffer, so handling only one char per loop let it
+		// overflow and drop chars whenever an effect was running.
+	    while (_serial.available()) {
+			_timeSinceLastChar = millis();
+			processChar(char(_serial.read()));
+		}
+
+		uint32_t newTime = millis();
+
+		// If we're capturing and it's been a while, error
+		if (_state != State::NotCapturing) {
+			if (newTime - _timeSinceLastChar > SerialTimeOut) {
+				_state = State::NotCapturing;
+				Serial.print(F("***** char timeout, rst\n"));
+				showStatus(StatusColor::Red, 3, 2);
+				_state = State::NotCapturing;
+				linkError();
+			}
+		}
+
+		// Don't delay here, or the serial port isn't read while we wait.
+		// Only run the effect when it's due.
+		if (int32_t(newTime - _nextEffectTime) < 0) {
+			return;
+		}
+
 		int32_t delayInMs = 0;
         if (_effect == Effect::Flash) {
             delayInMs = _flash.loop(&_pixels);
@@ -130,37 +254,36 @@ public:
 			delayInMs = 0;
 		}
 		
-		uint32_t newTime = millis();
-
-		// If we're capturing and it's been a while, error
-		if (_state != State::NotCapturing) {
-			if (newTime - _timeSinceLastChar > SerialTimeOut) {
-				_state = State::NotCapturing;
-				Serial.print(F("***** char timeout, rst\n"));
-				showStatus(StatusColor::Red, 3, 2);
-				_state = State::NotCapturing;
-			}
-		}
+		_nextEffectTime = millis() + delayInMs;
+	}
 
-	    if (_serial.available()) {
-			_timeSinceLastChar = newTime;
-			
-			char c = char(_serial.read());
-			
-			// Run the state machine
-			
-			switch(_state) {
-				case State::NotCapturing:
-					if (c == StartChar) {
+private:
+	void processChar(char c)
+	{
+		// Run the state machine
+		
+		switch(_state) {
+			case State::NotCapturing:
+				if (c == StartChar || c == CRCStartChar) {
                         _bufIndex = 0;
                         _buf[_bufIndex++] = c;
-						_state = State::DeviceAddr;
-						_expectedChecksum = c;
+					_state = State::DeviceAddr;
+					_expectedChecksum = c;
+                        _useCRC = c == CRCStartChar;
+                        _crc = crc8(0, c);
+                        _outCRC = _crc;
                         _cmdPassThrough = false;
                         _cmdExecute = false;
-					}
-					break;
-				case State::DeviceAddr:
+				} else {
+                        // Garbage between packets, maybe we're at the wrong rate
+                        linkError();
+                    }
+				break;
+			case State::DeviceAddr:
+                    // The incoming CRC is over the address we got, the outgoing
+                    // one over the address we send
+                    _crc = crc8(_crc, c);
+                    
                     if (c == '0') {
                         // If addr is '0' then this command is for all devices.
                         // Execute it and pass it through.
@@ -182,90 +305,133 @@ public:
                     
                     _buf[_bufIndex++] = c;
                     _state = State::Cmd;
-					_expectedChecksum += c;
-					break;
-				case State::Cmd:
+				_expectedChecksum += c;
+                    _outCRC = crc8(_outCRC, c);
+                    
+                    // Send the lead-in we've been holding, now that we know where this is going
+                    forward(_buf[0]);
+                    forward(c);
+				break;
+			case State::Cmd:
                     _buf[_bufIndex++] = c;
-					_cmd = c;
-					_state = State::SizeHi;
-					_expectedChecksum += c;
-					break;
-				case State::SizeHi:
+				_cmd = c;
+				_state = State::SizeHi;
+				accumulate(c);
+                    forward(c);
+				break;
+			case State::SizeHi:
                     _buf[_bufIndex++] = c;
-					_state = State::SizeLo;
-					_payloadSize = uint16_t(c) << 8;
-					_expectedChecksum += c;
-					break;
-				case State::SizeLo:
+				_state = State::SizeLo;
+				_payloadSize = uint16_t(c) << 8;
+				accumulate(c);
+                    forward(c);
+				break;
+			case State::SizeLo:
                     _buf[_bufIndex++] = c;
-					_payloadSize |= uint16_t(uint8_t(c));
+				_payloadSize |= uint16_t(uint8_t(c));
                     _payloadReceived = 0;
+                    forward(c);
                     Serial.print(F("Buffer size="));
                     Serial.println(_payloadSize);
-					
-                    if (_payloadSize > MaxPayloadSize) {
-						Serial.print(F("Buf too big. Size="));
-						Serial.println(_payloadSize);
-						showStatus(StatusColor::Red, 6, 1);
-						_state = State::NotCapturing;
-					} else {
-						_state = State::Data;
-						_expectedChecksum += c;
-					}
+				
+                    // When cutting through a packet we don't execute we never
+                    // need to hold the payload, so it can be any size
+                    if (CutThrough && !_cmdExecute) {
+                        _state = State::Data;
+                        accumulate(c);
+                    } else if (_payloadSize > MaxPayloadSize) {
+					Serial.print(F("Buf too big. Size="));
+					Serial.println(_payloadSize);
+					showStatus(StatusColor::Red, 6, 1);
+					_state = State::NotCapturing;
+                        linkError();
+				} else {
+					_state = State::Data;
+					accumulate(c);
+				}
 
                     if (_cmd == 'X') {
                         showStatus(StatusColor::Blue, 0, 0);
                     }
-					break;
-				case State::Data:
-					_buf[_bufIndex++] = c;
+				break;
+			case State::Data:
+                    if (!CutThrough || _cmdExecute) {
+                        _buf[_bufIndex++] = c;
+                    }
                     _payloadReceived++;
-					_expectedChecksum += c;
-					
-					if (_payloadReceived >= _payloadSize) {
-						_state = State::Checksum;
-					}
-					break;
-				case State::Checksum: {     
-                    // If we're passing through and not executing, we've decremented
-                    //  the address so we have to decrement the checksum as well
-					_actualChecksum = (_cmdPassThrough && !_cmdExecute) ? (c - 1) : c;
-					_buf[_bufIndex++] = _actualChecksum;
-					_state = State::LeadOut;
-					_expectedChecksum += '0';
-					break;
+				accumulate(c);
+                    forward(c);
+				
+				if (_payloadReceived >= _payloadSize) {
+					_state = State::Checksum;
 				}
-				case State::LeadOut:
-					if (c != EndChar) {
-						Serial.println(F("Exp lead-out"));
-						showStatus(StatusColor::Red, 6, 1);
+				break;
+			case State::Checksum: {     
+                    // If we're passing through and not executing, we've decremented
+                    //  the address so we have to decrement the checksum as well.
+                    // CRCs are linear, so the CRC of what we send is the
+                    // outgoing CRC with any error in the incoming one carried
+                    // over. A bad packet stays bad for the next device.
+                    uint8_t sendChecksum;
+                    if (_useCRC) {
+                        _actualChecksum = c;
+                        sendChecksum = _outCRC ^ _crc ^ uint8_t(c);
+                    } else {
+                        _actualChecksum = (_cmdPassThrough && !_cmdExecute) ? decrementChecksum(c) : c;
+                        sendChecksum = _actualChecksum;
+                    }
+                    if (!CutThrough || _cmdExecute) {
+                        _buf[_bufIndex++] = sendChecksum;
+                    }
+				_state = State::LeadOut;
+				_expectedChecksum += '0';
+                    forward(sendChecksum);
+				break;
+			}
+			case State::LeadOut:
+                    // Pass on whatever we got. If it's wrong the next device
+                    // will catch it
+                    forward(c);
+                    
+				if (c != (_useCRC ? CRCEndChar : EndChar)) {
+					Serial.println(F("Exp lead-out"));
+					showStatus(StatusColor::Red, 6, 1);
+					_state = State::NotCapturing;
+                        linkError();
+				} else {
+                        if (!CutThrough || _cmdExecute) {
+                            _buf[_bufIndex++] = c;
+                        }
+                        
+					// Make sure checksum is right
+                        if (_useCRC) {
+                            _expectedChecksum = _crc;
+                        } else {
+                            _expectedChecksum += c;
+                            _expectedChecksum = (_expectedChecksum & 0x3f) + 0x30;
+                        }
+					
+					if (_expectedChecksum != _actualChecksum) {
+						Serial.print(F("CRC ERROR: exp="));
+						Serial.print(_expectedChecksum);
+						Serial.print(F(", actual="));
+						Serial.print(_actualChecksum);
+						Serial.print(F(", cmd: "));
+						Serial.println(_cmd);
+						showStatus(StatusColor::Red, 5, 5);
 						_state = State::NotCapturing;
+                            linkError();
 					} else {
-                        _buf[_bufIndex++] = c;
-                        
-						// Make sure checksum is right
-						_expectedChecksum += c;
-						_expectedChecksum = (_expectedChecksum & 0x3f) + 0x30;
-						
-						if (_expectedChecksum != _actualChecksum) {
-							Serial.print(F("CRC ERROR: exp="));
-							Serial.print(_expectedChecksum);
-							Serial.print(F(", actual="));
-							Serial.print(_actualChecksum);
-							Serial.print(F(", cmd: "));
-							Serial.println(_cmd);
-							showStatus(StatusColor::Red, 5, 5);
-							_state = State::NotCapturing;
-						} else {
-							// Have a good buffer
-							_state = State::NotCapturing;
+						// Have a good buffer
+						_state = State::NotCapturing;
+                            _linkErrors = 0;
 
                             if (_cmd == 'X') {
                                 showStatus(StatusColor::Yellow, 0, 0);
                             }
 
-                            // Pass through buffer if needed
-                            if (_cmdPassThrough) {
+                            // Pass through buffer if needed (already done if cutting through)
+                            if (_cmdPassThrough && !cuttingThrough()) {
                                 for (uint16_t i = 0; i < _payloadSize + CommandSizeBefore + CommandSizeAfter; i++) {
                                     _serial.write(_buf[i]);
                                 }
@@ -279,44 +445,77 @@ public:
                                 break;
                             }
                             
+                            // Change the rate after forwarding, leaving the effect alone.
+                            // Only the whole chain can change, or it would be split
+                            if (_cmd == 'B') {
+                                if (_cmdPassThrough) {
+                                    setBaud(_buf[CommandSizeBefore]);
+                                } else {
+                                    Serial.println(F("B not broadcast"));
+                                    showStatus(StatusColor::Red, 3, 1);
+                                }
+                                break;
+                            }
+                            
+                            if (_cmd == 'H') {
+                                printPageHashes(_buf[CommandSizeBefore], _buf[CommandSizeBefore + 1]);
+                                break;
+                            }
+                            
                             // Handle the command
                             _effect = Effect::None;
-							
-							switch(_cmd) {
-								case 'C':
-								showColor(_buf[CommandSizeBefore], 
+
+                            // Start the new effect right away rather than when the old one was due
+                            _nextEffectTime = millis();
+						
+						switch(_cmd) {
+							case 'C':
+							showColor(_buf[CommandSizeBefore], 
                                           _buf[CommandSizeBefore + 1], 
                                           _buf[CommandSizeBefore + 2], 
                                           _buf[CommandSizeBefore + 3], 
                                           _buf[CommandSizeBefore + 4]);
-								break;
-								
-								case 'X': {
-									// Cancel effect
+							break;
+							
+							case 'X': {
+								// Cancel effect
                                     _effect = Effect::None;
-									
-									if (_payloadSize > 1024) {
-										Serial.print(F("inv EEPROM size="));
-										Serial.println(_payloadSize);
-										showStatus(StatusColor::Red, 5, 5);
-										_state = State::NotCapturing;
-									} else {
-										Serial.print(F("exec => EEPROM: size="));
-										Serial.println(_payloadSize);
-
-										for (uint16_t i = 0; i < _payloadSize; ++i) {
-											EEPROM[i] = _buf[i + CommandSizeBefore]; // Skip cmd chars and start addr
-										}
-									}
+								
+								if (_payloadSize > 1024) {
+									Serial.print(F("inv EEPROM size="));
+									Serial.println(_payloadSize);
+									showStatus(StatusColor::Red, 5, 5);
+									_state = State::NotCapturing;
+								} else {
+									Serial.print(F("exec => EEPROM: size="));
+									Serial.println(_payloadSize);
+
+									writeEEPROM(0, _buf + CommandSizeBefore, _payloadSize); // Skip cmd chars
+								}
                                     Serial.println(F("Finished upload"));
                                     showStatus(StatusColor::Blue, 5, 1);
-									break;
-								}
-								default:
-								// See if it's interpreted, payload is after cmd bytes, offset it
-								if (!_interpretedEffect.init(_cmd, _buf + CommandSizeBefore, _payloadSize)) {
-									String errorMsg;
-									switch(_interpretedEffect.error()) {
+								break;
+							}
+							case 'W': {
+                                    uint16_t addr = (uint16_t(_buf[CommandSizeBefore]) << 8) | _buf[CommandSizeBefore + 1];
+                                    uint16_t size = (_payloadSize < 2) ? 0 : (_payloadSize - 2);
+                                    
+                                    if (_payloadSize < 2 || addr + size > EEPROM.length()) {
+                                        Serial.print(F("inv EEPROM chunk addr="));
+                                        Serial.println(addr);
+                                        showStatus(StatusColor::Red, 5, 5);
+                                        break;
+                                    }
+                                    
+                                    writeEEPROM(addr, _buf + CommandSizeBefore + 2, size);
+                                    showStatus(StatusColor::Blue, 1, 1);
+								break;
+							}
+							default:
+							// See if it's interpreted, payload is after cmd bytes, offset it
+							if (!_interpretedEffect.init(_cmd, _buf + CommandSizeBefore, _payloadSize)) {
+								String errorMsg;
+								switch(_interpretedEffect.error()) {
                                         case clvr::Memory::Error::None:
                                         errorMsg = F("---");
                                         break;
@@ -374,30 +573,24 @@ public:
                                         case clvr::Memory::Error::InternalError:
                                         errorMsg = F("internal err");
                                         break;
-									}
+								}
 
-									Serial.print(F("Interp fx err: "));
-									Serial.println(errorMsg);
-									showStatus(StatusColor::Red, 5, 1);
-									_state = State::NotCapturing;
-								} else {
+								Serial.print(F("Interp fx err: "));
+								Serial.println(errorMsg);
+								showStatus(StatusColor::Red, 5, 1);
+								_state = State::NotCapturing;
+							} else {
                                     _effect = Effect::Interp;
-								}
-								break;
 							}
+							break;
 						}
 					}
+				}
 
-					break;
-			}
-	  	}
-
-		// Eventually we can't delay in loop because we have to feed the soft serial port
-		// But for now...
-		delay(delayInMs);
+				break;
+		}
 	}
 
-private:
 	static uint8_t checksum(const char* buf, int length) 
 	{
 	    uint8_t sum = 0;
@@ -408,6 +601,117 @@ private:
 	    return sum & 0x3f;
 	}
 
+    // The checksum is the low 6 bits of the sum plus 0x30. Adjust it for
+    // an address which was decremented by 1, wrapping within the 6 bits
+    static uint8_t decrementChecksum(uint8_t c)
+    {
+        return ((c - 0x30 - 1) & 0x3f) + 0x30;
+    }
+
+    // A packet we execute is held until it's been checked, even when
+    // it's also passed through
+    bool cuttingThrough() const { return CutThrough && _cmdPassThrough && !_cmdExecute; }
+
+    void forward(char c)
+    {
+        if (cuttingThrough()) {
+            _serial.write(c);
+        }
+    }
+
+    // Returns the number of bytes which had to be written. Unchanged bytes
+    // are skipped, which is faster and saves wear on the EEPROM
+    uint16_t writeEEPROM(uint16_t addr, const uint8_t* data, uint16_t size)
+    {
+        uint16_t written = 0;
+        for (uint16_t i = 0; i < size; ++i) {
+            if (EEPROM.read(addr + i) != data[i]) {
+                EEPROM.write(addr + i, data[i]);
+                written++;
+            }
+        }
+        
+        Serial.print(F("EEPROM addr="));
+        Serial.print(addr);
+        Serial.print(F(" size="));
+        Serial.print(size);
+        Serial.print(F(" written="));
+        Serial.println(written);
+        return written;
+    }
+    
+    static uint16_t pageHash(uint16_t page)
+    {
+        // Fletcher-16
+        uint16_t sum1 = 0;
+        uint16_t sum2 = 0;
+        for (uint16_t i = page * EEPROMPageSize; i < (page + 1) * EEPROMPageSize; ++i) {
+            sum1 = (sum1 + EEPROM.read(i)) % 255;
+            sum2 = (sum2 + sum1) % 255;
+        }
+        return (sum2 << 8) | sum1;
+    }
+    
+    void printPageHashes(uint8_t page, uint8_t count)
+    {
+        uint16_t numPages = EEPROM.length() / EEPROMPageSize;
+        for ( ; count > 0 && page < numPages; --count, ++page) {
+            Serial.print(F("H "));
+            Serial.print(page);
+            Serial.print(' ');
+            Serial.println(pageHash(page), HEX);
+        }
+    }
+    
+    static uint8_t crc8(uint8_t crc, char c)
+    {
+        return pgm_read_byte(&CRCTable[crc ^ uint8_t(c)]);
+    }
+    
+    // Add a char which is sent unchanged to the incoming and outgoing checks
+    void accumulate(char c)
+    {
+        _expectedChecksum += c;
+        _crc = crc8(_crc, c);
+        _outCRC = crc8(_outCRC, c);
+    }
+    
+    // The rate is printed even when it doesn't change, so a resent 'B'
+    // can be seen to have arrived
+    void setBaud(uint8_t index)
+    {
+        if (index >= NumBaudRates) {
+            return;
+        }
+        
+        if (index != _baudIndex) {
+            _serial.end();
+            _serial.begin(BaudRates[index]);
+            _baudIndex = index;
+        }
+        _linkErrors = 0;
+        
+        Serial.print(F("Baud="));
+        Serial.println(BaudRates[index]);
+    }
+    
+    // Errors at the base rate are just errors. Above it, enough of them
+    // mean the link can't run that fast (or the sender has gone back to
+    // the base rate), so fall back and take the next device with us.
+    void linkError()
+    {
+        if (_baudIndex == BaseBaudIndex || ++_linkErrors < MaxLinkErrors) {
+            return;
+        }
+        
+        Serial.println(F("Link errs, fallback"));
+        setBaud(BaseBaudIndex);
+        
+        for (uint8_t i = 0; i < SyncLength; ++i) {
+            _serial.write(SyncChar);
+        }
+    }
+
 	enum class StatusColor { Red, Green, Yellow, Blue };
 
 	void showColor(uint8_t h, uint8_t s, uint8_t v, uint8_t n, uint8_t d)
@@ -447,9 +751,17 @@ private:
 	uint16_t _payloadSize = 0;
     
 	unsigned long _timeSinceLastChar = 0;
+	uint32_t _nextEffectTime = 0;
 	
 	uint8_t _expectedChecksum = 0;
 	uint8_t _actualChecksum = 0;
+    
+    bool _useCRC = false;
+    uint8_t _crc = 0; // Of the bytes received
+    uint8_t _outCRC = 0; // Of the bytes sent, which differ if the address was decremented
+    
+    uint8_t _baudIndex = BaseBaudIndex;
+    uint8_t _linkErrors = 0;
 	
 	uint8_t _cmd = '0';
  
@@ -0,0 +1,435 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "SyncClock.h"
+
+#include "System.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#else
+#include <chrono>
+#endif
+
+static const char* TAG = "SyncClock";
+
+static constexpr uint8_t Version = 1;
+static constexpr uint8_t Request = 0;
+static constexpr uint8_t Reply = 1;
+
+struct SyncClock::Packet
+{
+    char magic[4]; // "PLCS"
+    uint8_t version;
+    uint8_t type;
+    uint16_t reserved;
+    uint32_t seq;
+    uint64_t t1; // Follower's send time
+    uint64_t t2; // Master's receive time
+    uint64_t t3; // Master's send time
+};
+
+bool
+SyncClock::load(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+
+    char text[256];
+    size_t length = fread(text, 1, sizeof(text), f);
+    fclose(f);
+    return parse(text, length);
+}
+
+bool
+SyncClock::parse(const char* text, size_t length)
+{
+    Role role = Role::Off;
+    char master[40] = "";
+    unsigned int port = DefaultPort;
+
+    while (length > 0) {
+        // One line at a time, without its comment
+        size_t lineLength = 0;
+        while (lineLength < length && text[lineLength] != '\n') {
+            ++lineLength;
+        }
+
+        char line[80];
+        size_t n = (lineLength < sizeof(line) - 1) ? lineLength : sizeof(line) - 1;
+        memcpy(line, text, n);
+        line[n] = '\0';
+        char* comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        text += lineLength;
+        length -= lineLength;
+        if (length > 0) {
+            ++text;
+            --length;
+        }
+
+        char key[16];
+        char value[40];
+        int values = sscanf(line, "%15s %39s", key, value);
+        if (values <= 0) {
+            continue;
+        }
+
+        if (strcmp(key, "master") == 0 && values == 1) {
+            role = Role::Master;
+        } else if (strcmp(key, "follow") == 0 && values == 2) {
+            role = Role::Follower;
+            strcpy(master, value);
+        } else if (strcmp(key, "port") == 0 && values == 2) {
+            port = unsigned(atoi(value));
+        } else {
+            return false;
+        }
+    }
+
+    if (role == Role::Off || port == 0 || port > 65535) {
+        return false;
+    }
+
+    _role = role;
+    _master = master;
+    _port = uint16_t(port);
+    return true;
+}
+
+bool
+SyncClock::begin(Role role, const char* master, uint16_t port)
+{
+    _role = role;
+    _master = master ? master : "";
+    _port = port;
+    return begin();
+}
+
+bool
+SyncClock::begin()
+{
+    end();
+
+    if (_role == Role::Off) {
+        return true;
+    }
+
+    _socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (_socket < 0) {
+        mil::System::logE(TAG, "Can't create socket");
+        _role = Role::Off;
+        return false;
+    }
+
+    // The master listens on the port. Followers send from any port
+    sockaddr_in addr = { };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((_role == Role::Master) ? _port : 0);
+    if (bind(_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        mil::System::logE(TAG, "Can't bind port %d", int(_port));
+        end();
+        _role = Role::Off;
+        return false;
+    }
+
+    // Wake up now and then to see if it's time to stop
+    timeval timeout = { 0, 100000 };
+    setsockopt(_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    _listening = true;
+    if (_role == Role::Master) {
+        _listener = std::thread([this]() { serve(); });
+    } else {
+        _listener = std::thread([this]() { receive(); });
+    }
+
+    mil::System::logI(TAG, "%s on port %d", (_role == Role::Master) ? "Master" : ("Following " + _master).c_str(), int(_port));
+    return true;
+}
+
+void
+SyncClock::end()
+{
+    if (_listener.joinable()) {
+        _listening = false;
+        _listener.join();
+    }
+    if (_socket >= 0) {
+        close(_socket);
+        _socket = -1;
+    }
+    _locked = false;
+    _skew = 0;
+    _numSamples = 0;
+    _nextSample = 0;
+    _numSkewPoints = 0;
+    _nextSkewPoint = 0;
+    _waitingSeq = 0;
+    _replied = false;
+}
+
+void
+SyncClock::serve()
+{
+    Packet packet;
+    sockaddr_in from;
+
+    while (_listening) {
+        socklen_t fromLength = sizeof(from);
+        ssize_t size = recvfrom(_socket, &packet, sizeof(packet), 0, reinterpret_cast<sockaddr*>(&from), &fromLength);
+        uint64_t received = localMicros();
+        if (size != sizeof(packet) || memcmp(packet.magic, "PLCS", 4) != 0 || packet.version != Version || packet.type != Request) {
+            continue;
+        }
+
+        packet.type = Reply;
+        packet.t2 = received;
+        packet.t3 = localMicros();
+        if (sendto(_socket, &packet, sizeof(packet), 0, reinterpret_cast<sockaddr*>(&from), fromLength) == sizeof(packet)) {
+            _stats.served++;
+        }
+    }
+}
+
+void
+SyncClock::receive()
+{
+    Packet packet;
+
+    while (_listening) {
+        ssize_t size = recvfrom(_socket, &packet, sizeof(packet), 0, nullptr, nullptr);
+        uint64_t received = localMicros();
+        if (size != sizeof(packet) || memcmp(packet.magic, "PLCS", 4) != 0 || packet.version != Version || packet.type != Reply) {
+            continue;
+        }
+
+        // Late replies, to requests already counted as lost, are thrown away
+        std::lock_guard<std::mutex> lock(_replyMutex);
+        if (packet.seq == _waitingSeq && !_replied) {
+            _reply = { packet.t1, packet.t2, packet.t3, received };
+            _replied = true;
+        }
+    }
+}
+
+bool
+SyncClock::takeReply(ReplyTimes& reply)
+{
+    std::lock_guard<std::mutex> lock(_replyMutex);
+    if (!_waitingSeq) {
+        return false;
+    }
+
+    if (!_replied) {
+        if (localMicros() - _lastRequest >= uint64_t(ReplyTimeout) * 1000) {
+            _stats.lost++;
+            _waitingSeq = 0;
+        }
+        return false;
+    }
+
+    reply = _reply;
+    _waitingSeq = 0;
+    _replied = false;
+    return true;
+}
+
+void
+SyncClock::loop()
+{
+    if (_socket < 0 || _role != Role::Follower) {
+        return;
+    }
+
+    ReplyTimes reply;
+    if (takeReply(reply)) {
+        _stats.replies++;
+        int64_t offset = (int64_t(reply.t2 - reply.t1) + int64_t(reply.t3 - reply.t4)) / 2;
+        int64_t rtt = int64_t(reply.t4 - reply.t1) - int64_t(reply.t3 - reply.t2);
+        addSample(offset, uint32_t((rtt > 0) ? rtt : 0), reply.t4);
+    }
+
+    // Poll fast until locked, then settle down
+    uint64_t now = localMicros();
+    uint64_t interval = uint64_t(_locked ? PollInterval : FastPollInterval) * 1000;
+    if (_lastRequest && now - _lastRequest < interval) {
+        return;
+    }
+    _lastRequest = now;
+
+    sockaddr_in to = { };
+    to.sin_family = AF_INET;
+    to.sin_port = htons(_port);
+    if (inet_pton(AF_INET, _master.c_str(), &to.sin_addr) != 1) {
+        mil::System::logE(TAG, "Bad master address '%s'", _master.c_str());
+        end();
+        _role = Role::Off;
+        return;
+    }
+
+    Packet packet;
+    memset(&packet, 0, sizeof(packet));
+    memcpy(packet.magic, "PLCS", 4);
+    packet.version = Version;
+    packet.type = Request;
+    packet.seq = ++_seq;
+    packet.t1 = localMicros();
+
+    // Ready for the reply before it can come
+    std::lock_guard<std::mutex> lock(_replyMutex);
+    _waitingSeq = packet.seq;
+    _replied = false;
+    if (sendto(_socket, &packet, sizeof(packet), 0, reinterpret_cast<sockaddr*>(&to), sizeof(to)) != sizeof(packet)) {
+        _waitingSeq = 0;
+        return;
+    }
+    _stats.requests++;
+}
+
+void
+SyncClock::addSample(int64_t offset, uint32_t rtt, uint64_t time)
+{
+    _samples[_nextSample] = { offset, rtt, time };
+    _nextSample = (_nextSample + 1) % NumSamples;
+    if (_numSamples < NumSamples) {
+        ++_numSamples;
+    }
+
+    const Sample* best = &_samples[0];
+    for (uint8_t i = 1; i < _numSamples; ++i) {
+        if (_samples[i].rtt < best->rtt) {
+            best = &_samples[i];
+        }
+    }
+
+    // Where the clock is now, before the skew changes
+    int64_t current = offsetAt(time);
+
+    addSkewPoint(*best);
+    if (_numSkewPoints >= MinSkewPoints) {
+        _skew = fitSkew();
+    }
+
+    // The best sample may be a few polls old, so bring it up to date
+    int64_t target = best->offset + int64_t(_skew * double(int64_t(time - best->time)));
+
+    // Jump to the first one. After that take a quarter of the error into
+    // the offset, so one odd sample doesn't jerk the effects
+    if (!_locked) {
+        _offset = target;
+        _locked = true;
+    } else {
+        _offset = current + (target - current) / 4;
+    }
+    _base = time;
+
+    int64_t deviation = offset - _offset;
+    if (deviation < 0) {
+        deviation = -deviation;
+    }
+    _stats.jitter += int32_t((deviation - int64_t(_stats.jitter)) / 16);
+    _stats.offset = _offset;
+    _stats.skew = float(_skew * 1e6);
+    _stats.rtt = best->rtt;
+}
+
+void
+SyncClock::addSkewPoint(const Sample& sample)
+{
+    // The best sample is often the same for several polls
+    if (_numSkewPoints > 0 && _skewPoints[(_nextSkewPoint + NumSkewPoints - 1) % NumSkewPoints].time == sample.time) {
+        return;
+    }
+
+    _skewPoints[_nextSkewPoint] = sample;
+    _nextSkewPoint = (_nextSkewPoint + 1) % NumSkewPoints;
+    if (_numSkewPoints < NumSkewPoints) {
+        ++_numSkewPoints;
+    }
+}
+
+double
+SyncClock::fitSkew() const
+{
+    // Least squares slope of offset against time. Both are taken relative
+    // to the first point so doubles keep their precision
+    const Sample& first = _skewPoints[0];
+    double meanTime = 0;
+    double meanOffset = 0;
+    for (uint8_t i = 0; i < _numSkewPoints; ++i) {
+        meanTime += double(int64_t(_skewPoints[i].time - first.time));
+        meanOffset += double(_skewPoints[i].offset - first.offset);
+    }
+    meanTime /= _numSkewPoints;
+    meanOffset /= _numSkewPoints;
+
+    double covariance = 0;
+    double variance = 0;
+    for (uint8_t i = 0; i < _numSkewPoints; ++i) {
+        double t = double(int64_t(_skewPoints[i].time - first.time)) - meanTime;
+        covariance += t * (double(_skewPoints[i].offset - first.offset) - meanOffset);
+        variance += t * t;
+    }
+    return (variance > 0) ? covariance / variance : _skew;
+}
+
+uint32_t
+SyncClock::millis() const
+{
+    if (_role == Role::Off) {
+        return mil::System::millis();
+    }
+
+    uint32_t ms = uint32_t(micros() / 1000);
+    if (int32_t(ms - _lastMillis) > 0) {
+        _lastMillis = ms;
+    }
+    return _lastMillis;
+}
+
+uint64_t
+SyncClock::localMicros() const
+{
+#ifdef ESP_PLATFORM
+    return uint64_t(esp_timer_get_time());
+#else
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+std::string
+SyncClock::statsString() const
+{
+    const char* role = (_role == Role::Master) ? "master" : ((_role == Role::Follower) ? "follower" : "off");
+    return std::string("sync ") + role
+         + " locked=" + (locked() ? "1" : "0")
+         + " offset=" + std::to_string(_stats.offset)
+         + "us skew=" + std::to_string(int(_stats.skew))
+         + "ppm rtt=" + std::to_string(_stats.rtt)
+         + "us jitter=" + std::to_string(_stats.jitter)
+         + "us requests=" + std::to_string(_stats.requests)
+         + " replies=" + std::to_string(_stats.replies)
+         + " lost=" + std::to_string(_stats.lost)
+         + " served=" + std::to_string(_stats.served.load());
+}
@@ -0,0 +1,177 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// SyncClock Class
+//
+// A clock shared by several controllers on the LAN so their effects stay
+// in phase. One controller is the master and the others follow it. Each
+// follower sends the master a small UDP request twice a second and
+// the master answers with the times it received the request and sent the
+// reply. Like NTP, the follower works out its offset from the master
+// and the round trip time from those and its own send and receive times:
+//
+//      offset = ((t2 - t1) + (t3 - t4)) / 2
+//      rtt = (t4 - t1) - (t3 - t2)
+//
+// The master answers from its own thread, blocked waiting for requests.
+// A follower sends from the frame loop and takes replies in its own
+// thread, so the times are taken as packets arrive rather than when the
+// frame loop gets to them, and the frame loop never waits. The next
+// loop() uses the reply, or counts it lost after ReplyTimeout. The sample with the shortest round trip of the last few is the
+// one least delayed by the network, so it's used. Crystals differ by tens
+// of ppm, so the follower also tracks how fast its clock runs compared to
+// the master's and keeps correcting for it between samples. That skew is
+// the slope of a least squares fit to the best samples of the last
+// NumSkewPoints polls, about 16 seconds, which is long enough for the
+// network's noise to average out. Offset corrections are eased in rather
+// than jumped to, and millis() never goes backwards.
+// jitter is a running average of how far each sample's offset is from
+// the clock's.
+//
+// The role comes from a text file, like the topology:
+//
+//      master                  # or
+//      follow 192.168.1.20     # the master's address
+//      port 4210               # optional
+//
+// Without it the clock is Off and millis() is just the System's.
+// Packets are little endian, as on every platform we build for.
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+class SyncClock
+{
+public:
+    static constexpr uint16_t DefaultPort = 4210;
+    static constexpr uint32_t PollInterval = 500; // ms between requests
+    static constexpr uint32_t FastPollInterval = 100; // ms, until locked
+    static constexpr uint32_t ReplyTimeout = 20; // ms
+    static constexpr uint8_t NumSamples = 4;
+    static constexpr uint8_t NumSkewPoints = 32;
+    static constexpr uint8_t MinSkewPoints = 4;
+
+    enum class Role { Off, Master, Follower };
+
+    struct Stats
+    {
+        uint32_t requests = 0;
+        uint32_t replies = 0;
+        uint32_t lost = 0;
+        std::atomic<uint32_t> served { 0 }; // Requests answered by the master
+        int64_t offset = 0; // us
+        float skew = 0; // ppm the master runs faster than us
+        uint32_t rtt = 0; // us, of the sample in use
+        uint32_t jitter = 0; // us
+    };
+
+    SyncClock() { }
+    virtual ~SyncClock() { end(); }
+
+    // Read the role from a file. Returns false, leaving it Off, if the file
+    // can't be read or isn't valid
+    bool load(const char* path);
+    bool parse(const char* text, size_t length);
+
+    // Start or stop sending and answering requests
+    bool begin();
+    bool begin(Role, const char* master, uint16_t port = DefaultPort);
+    void end();
+
+    // Use the reply to the last request if it's come, and send the next
+    // request when it's due. Doesn't wait. Does nothing on the master
+    void loop();
+
+    Role role() const { return _role; }
+    bool synced() const { return _role != Role::Off; }
+    bool locked() const { return _role == Role::Master || _locked; }
+
+    // Time on the master's clock
+    uint64_t micros() const
+    {
+        uint64_t local = localMicros();
+        return local + offsetAt(local);
+    }
+    uint32_t millis() const;
+
+    const Stats& stats() const { return _stats; }
+    std::string statsString() const;
+
+protected:
+    // The local clock. Virtual so a test can run several clocks in one process
+    virtual uint64_t localMicros() const;
+
+private:
+    struct Packet;
+    struct Sample
+    {
+        int64_t offset;
+        uint32_t rtt;
+        uint64_t time; // Local time it was received
+    };
+
+    int64_t offsetAt(uint64_t local) const { return _offset + int64_t(_skew * double(int64_t(local - _base))); }
+
+    // The times of a request and its reply, as received
+    struct ReplyTimes
+    {
+        uint64_t t1;
+        uint64_t t2;
+        uint64_t t3;
+        uint64_t t4;
+    };
+
+    void serve();
+    void receive();
+    bool takeReply(ReplyTimes&);
+    void addSample(int64_t offset, uint32_t rtt, uint64_t time);
+    void addSkewPoint(const Sample&);
+    double fitSkew() const;
+
+    Role _role = Role::Off;
+    std::string _master;
+    uint16_t _port = DefaultPort;
+    int _socket = -1;
+    std::thread _listener; // serve() on the master, receive() on a follower
+    std::atomic<bool> _listening { false };
+
+    // The offset from the master is _offset at local time _base and
+    // changes by _skew us per us
+    int64_t _offset = 0;
+    uint64_t _base = 0;
+    double _skew = 0;
+    bool _locked = false;
+    Sample _samples[NumSamples] = { };
+    uint8_t _numSamples = 0;
+    uint8_t _nextSample = 0;
+
+    // The best sample as of each poll, for fitting the skew
+    Sample _skewPoints[NumSkewPoints] = { };
+    uint8_t _numSkewPoints = 0;
+    uint8_t _nextSkewPoint = 0;
+
+    uint32_t _seq = 0;
+    uint64_t _lastRequest = 0;
+    
+    // The request waiting for a reply (0 for none) and the reply, once
+    // receive() has it
+    std::mutex _replyMutex;
+    uint32_t _waitingSeq = 0;
+    bool _replied = false;
+    ReplyTimes _reply = { };
+    mutable uint32_t _lastMillis = 0;
+
+    Stats _stats;
+};
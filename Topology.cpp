@@ -0,0 +1,123 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "Topology.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool
+Topology::load(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+
+    // A file which fills the buffer may have been cut off, so it's
+    // rejected rather than parsed without its end
+    char text[MaxFileSize];
+    size_t length = fread(text, 1, sizeof(text), f);
+    fclose(f);
+    return length < sizeof(text) && parse(text, length);
+}
+
+bool
+Topology::parse(const char* text, size_t length)
+{
+    // Work on a copy so nothing changes unless it's all valid
+    Topology t;
+    t._numStrands = 0;
+    uint32_t numPosts = 0;
+    uint32_t pixelsPerPost = DefaultPixelsPerPost;
+
+    while (length > 0) {
+        // One line at a time, without its comment
+        size_t lineLength = 0;
+        while (lineLength < length && text[lineLength] != '\n') {
+            ++lineLength;
+        }
+
+        char line[80];
+        size_t n = (lineLength < sizeof(line) - 1) ? lineLength : sizeof(line) - 1;
+        memcpy(line, text, n);
+        line[n] = '\0';
+        char* comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        text += lineLength;
+        length -= lineLength;
+        if (length > 0) {
+            ++text;
+            --length;
+        }
+
+        char key[16];
+        unsigned int a = 0;
+        unsigned int b = 0;
+        int values = sscanf(line, "%15s %u %u", key, &a, &b);
+        if (values <= 0) {
+            continue;
+        }
+
+        if (strcmp(key, "posts") == 0 && values == 2) {
+            numPosts = a;
+        } else if (strcmp(key, "pixelsPerPost") == 0 && values == 2) {
+            pixelsPerPost = a;
+        } else if (strcmp(key, "strand") == 0 && values == 3 && t._numStrands < MaxStrands && a <= 255 && b > 0) {
+            Strand& strand = t._strands[t._numStrands++];
+            strand.pin = uint8_t(a);
+            strand.numPosts = uint16_t((b <= MaxPosts) ? b : MaxPosts + 1);
+        } else {
+            return false;
+        }
+    }
+
+    if (numPosts == 0 || numPosts > MaxPosts || pixelsPerPost == 0 || pixelsPerPost > MaxPixels || numPosts * pixelsPerPost > MaxPixels) {
+        return false;
+    }
+
+    if (t._numStrands == 0) {
+        t._strands[0] = { DefaultPin, 0, uint16_t(numPosts) };
+        t._numStrands = 1;
+    }
+
+    // Strands must cover all the posts
+    uint32_t firstPost = 0;
+    for (uint8_t i = 0; i < t._numStrands; ++i) {
+        t._strands[i].firstPost = uint16_t(firstPost);
+        firstPost += t._strands[i].numPosts;
+    }
+    if (firstPost != numPosts) {
+        return false;
+    }
+
+    t._numPosts = uint16_t(numPosts);
+    t._pixelsPerPost = uint16_t(pixelsPerPost);
+    *this = t;
+    return true;
+}
+
+std::string
+Topology::toString() const
+{
+    std::string s = "posts=" + std::to_string(_numPosts)
+                  + " pixelsPerPost=" + std::to_string(_pixelsPerPost)
+                  + " strands=";
+    for (uint8_t i = 0; i < _numStrands; ++i) {
+        if (i > 0) {
+            s += ",";
+        }
+        s += std::to_string(_strands[i].numPosts) + "@" + std::to_string(_strands[i].pin);
+    }
+    return s;
+}
@@ -0,0 +1,72 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Topology Class
+//
+// The layout of the lights: how many posts, how many pixels on each and
+// which strands (each on its own pin) they're wired to. Posts are numbered
+// along the strands in order, so the first strand has the first posts.
+// It's loaded at boot from a text file with one setting per line:
+//
+//      # Comments start with '#'
+//      posts 60
+//      pixelsPerPost 8
+//      strand 10 30        # pin, number of posts
+//      strand 11 30
+//
+// Without any strand lines all posts are on one strand on the default
+// pin. Anything missing or invalid leaves the defaults, which match the
+// original single 7 post strand.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class Topology
+{
+public:
+    static constexpr uint16_t DefaultPosts = 7;
+    static constexpr uint16_t DefaultPixelsPerPost = 8;
+    static constexpr uint8_t DefaultPin = 10;
+
+    static constexpr uint8_t MaxStrands = 8;
+    static constexpr uint16_t MaxPosts = 512;
+    static constexpr size_t MaxFileSize = 1024;
+    static constexpr uint16_t MaxPixels = 4096;
+
+    struct Strand
+    {
+        uint8_t pin;
+        uint16_t firstPost;
+        uint16_t numPosts;
+    };
+
+    Topology() { }
+
+    // Returns false, leaving the defaults, if the file can't be read, is
+    // MaxFileSize bytes or more, or isn't valid
+    bool load(const char* path);
+    bool parse(const char* text, size_t length);
+
+    uint16_t numPosts() const { return _numPosts; }
+    uint16_t pixelsPerPost() const { return _pixelsPerPost; }
+    uint16_t numPixels() const { return _numPosts * _pixelsPerPost; }
+    uint8_t numStrands() const { return _numStrands; }
+    const Strand& strand(uint8_t i) const { return _strands[i]; }
+
+    std::string toString() const;
+
+private:
+    uint16_t _numPosts = DefaultPosts;
+    uint16_t _pixelsPerPost = DefaultPixelsPerPost;
+    uint8_t _numStrands = 1;
+    Strand _strands[MaxStrands] = { { DefaultPin, 0, DefaultPosts } };
+};
@@ -0,0 +1,86 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "Transition.h"
+
+#include "FrameBuffer.h"
+#include "System.h"
+
+#include <string.h>
+
+size_t
+Transition::configure()
+{
+    _frameBuffer->endFade();
+    delete [ ] _from;
+
+    _numPixels = _frameBuffer->numPixels();
+    _from = new uint8_t[_numPixels * 3]();
+    _active = false;
+    return _numPixels * 3;
+}
+
+void
+Transition::start(uint32_t duration)
+{
+    if (!_from) {
+        _frameBuffer->clear();
+        return;
+    }
+
+    // Keep what's on the lights. In the middle of a fade that's the blend
+    // of the frame we were fading from and what's been drawn since
+    const uint8_t* pixels = _frameBuffer->pixels();
+    if (_active && _duration) {
+        uint32_t elapsed = mil::System::millis() - _start;
+        uint16_t a = (elapsed < _duration) ? uint16_t(elapsed * 255 / _duration) : 255;
+        for (uint16_t i = 0; i < _numPixels * 3; ++i) {
+            _from[i] = uint8_t((_from[i] * (255 - a) + pixels[i] * a + 127) / 255);
+        }
+    } else {
+        memcpy(_from, pixels, _numPixels * 3);
+    }
+
+    _frameBuffer->clear();
+    _start = mil::System::millis();
+    _duration = duration;
+    _active = true;
+
+    if (_duration) {
+        _frameBuffer->fadeFrom(_from, 0);
+    } else {
+        _frameBuffer->endFade();
+    }
+}
+
+void
+Transition::finish()
+{
+    _frameBuffer->endFade();
+    _active = false;
+}
+
+int32_t
+Transition::loop()
+{
+    if (!_active) {
+        return 0;
+    }
+
+    uint32_t elapsed = mil::System::millis() - _start;
+    if (elapsed >= _duration) {
+        finish();
+        return 0;
+    }
+
+    _frameBuffer->fadeFrom(_from, uint8_t(elapsed * 255 / _duration));
+
+    int32_t remaining = int32_t(_duration - elapsed);
+    return (remaining < StepInterval) ? remaining : StepInterval;
+}
@@ -0,0 +1,61 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Transition Class
+//
+// Changes from one effect to the next without blanking the lights. When
+// a command comes in, start() keeps a copy of what's on the lights and
+// clears the FrameBuffer for the new effect to draw on. With no duration
+// the lights keep the old frame until the next show(), when the new one
+// replaces it. Otherwise loop() steps a crossfade from the old frame to
+// what the new effect draws over duration ms. It's called each frame
+// before the effect runs, so the effect's show() sends this step. The
+// caller shows the frame if the effect didn't.
+//
+// Effects are single instances which all draw to the one FrameBuffer, so
+// the old effect is stopped and the fade is from its last frame. Starting
+// another transition during a fade fades from the blend on the lights.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class FrameBuffer;
+
+class Transition
+{
+public:
+    static constexpr int32_t StepInterval = 20; // ms
+
+    Transition(FrameBuffer* frameBuffer) : _frameBuffer(frameBuffer) { }
+    ~Transition() { delete [ ] _from; }
+
+    // Size for the FrameBuffer's topology. Returns the number of bytes allocated
+    size_t configure();
+
+    void start(uint32_t duration);
+
+    // Stop any fade and leave what's drawn on the lights
+    void finish();
+
+    bool active() const { return _active; }
+
+    // Set up this frame's step. Returns the ms until the next one, or 0
+    // once it's done
+    int32_t loop();
+
+private:
+    FrameBuffer* _frameBuffer;
+    uint8_t* _from = nullptr;
+    uint16_t _numPixels = 0;
+    uint32_t _start = 0;
+    uint32_t _duration = 0;
+    bool _active = false;
+};
@@ -30,8 +30,9 @@
 -- So the first PixelsPerPost entries are for the first post, the next entries
 -- are for the second post and so on.
 
-local PixelsPerPost = 8
-local NumPosts = 7
+-- The controller passes its topology. The defaults are for running as a shell command
+local PixelsPerPost = pixelsPerPost or 8
+local NumPosts = numPosts or 7
 local NumPixels = PixelsPerPost * NumPosts
 local Delay = 30; -- Delay between iterations (in ms)
 
@@ -63,6 +64,28 @@ local brightnessMax = math.max(FlickerBrightestMin, math.min(255, v))
 local speedMin = speed + 1
 local speedMax = speed + 2
 
+function waitForNextFrame(loopStartTime)
+	local delayTime = Delay - (millis() - loopStartTime)
+	if delayTime < 1 then
+		delayTime = 1
+	end
+	delay(delayTime)
+end
+
+-- If we have the native animator, let it do all the per pixel work. Entries
+-- start at 0, so they all respawn on the first step
+if animator then
+	animator.setup(NumPixels)
+	animator.respawn(FlickerMin, speedMin, speedMax, FlickerBrightestMin, brightnessMax)
+	
+	while true do
+		local loopStartTime = millis();
+		animator.step(h, s, v)
+		refreshLEDs(1)
+		waitForNextFrame(loopStartTime)
+	end
+end
+
 local ledCur = { }
 clearArray(ledCur, NumPixels)
 local ledInc = { }
@@ -110,10 +133,5 @@ while true do
 		setLED(1, i - 1, hsvToRGB(h, s, ledCur[i] / 128))
 	end
 	refreshLEDs(1)
-	
-	local delayTime = Delay - (millis() - loopStartTime)
-	if delayTime < 1 then
-		delayTime = 1
-	end
-	delay(delayTime)
+	waitForNextFrame(loopStartTime)
 end
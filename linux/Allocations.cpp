@@ -0,0 +1,81 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "Allocations.h"
+
+#include <atomic>
+#include <malloc.h>
+#include <new>
+#include <stdlib.h>
+
+static std::atomic<uint64_t> allocationCount { 0 };
+static std::atomic<size_t> live { 0 };
+static std::atomic<size_t> peak { 0 };
+
+void*
+operator new(size_t size)
+{
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+
+    allocationCount++;
+
+    // Count what malloc actually gave us, so delete can take off the same amount
+    size_t now = live += malloc_usable_size(p);
+    size_t highest = peak;
+    while (now > highest && !peak.compare_exchange_weak(highest, now)) { }
+    return p;
+}
+
+void
+operator delete(void* p) noexcept
+{
+    if (p) {
+        live -= malloc_usable_size(p);
+        free(p);
+    }
+}
+
+void
+operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+uint64_t
+Allocations::count()
+{
+    return allocationCount;
+}
+
+size_t
+Allocations::liveBytes()
+{
+    return live;
+}
+
+size_t
+Allocations::peakBytes()
+{
+    return peak;
+}
+
+void
+Allocations::resetPeak()
+{
+    peak = size_t(live);
+}
+
+size_t
+Allocations::heapBytes()
+{
+    return mallinfo2().uordblks;
+}
@@ -0,0 +1,34 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Allocations
+//
+// Replaces the global operator new and delete in the headless tools so
+// they can report how many allocations were made and the high water mark
+// of allocated memory. Lua allocates with realloc, which this doesn't see,
+// so heapBytes() gives everything malloc has handed out.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Allocations
+{
+public:
+    static uint64_t count();
+    static size_t liveBytes();
+
+    // Highest liveBytes() since the last resetPeak()
+    static size_t peakBytes();
+    static void resetPeak();
+
+    // All of the heap in use, including memory not from operator new
+    static size_t heapBytes();
+};
@@ -0,0 +1,62 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Headless Application
+//
+// Stands in for ESPlib's Application in the Linux build. HTTP handlers
+// are called directly with request() and there is no shell, so Lua
+// scripts only run in process (see LuaEffect.h).
+
+#pragma once
+
+#include "System.h"
+#include "WiFiPortal.h"
+
+#include <functional>
+#include <map>
+#include <string>
+
+namespace mil {
+
+class Application
+{
+public:
+    using HTTPHandler = std::function<bool(WiFiPortal*)>;
+
+    Application(WiFiPortal* portal, const char*, bool) : _portal(portal) { }
+    virtual ~Application() { }
+
+    virtual void setup() { }
+    virtual void loop() { }
+
+    void setTitle(const char*) { }
+    void addHTTPHandler(const char* path, HTTPHandler handler) { _handlers[path] = handler; }
+
+    int8_t handleShellCommand(const std::string&) { return -1; }
+    void terminateShellCommand(int8_t) { }
+
+    // Headless only. Returns false if there's no handler for path
+    bool request(const char* path, const std::map<std::string, std::string>& args)
+    {
+        auto it = _handlers.find(path);
+        if (it == _handlers.end()) {
+            return false;
+        }
+        _portal->setArgs(args);
+        return it->second(_portal);
+    }
+
+protected:
+    WiFiPortal* _portal;
+
+private:
+    std::map<std::string, HTTPHandler> _handlers;
+};
+
+}
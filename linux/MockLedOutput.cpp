@@ -0,0 +1,117 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "MockLedOutput.h"
+
+#include <algorithm>
+#include <string.h>
+
+bool
+MockLedOutput::begin(uint8_t strand, uint8_t, uint16_t count)
+{
+    if (strand < 1 || strand > Topology::MaxStrands) {
+        return false;
+    }
+
+    Strand& s = _strands[strand - 1];
+    s.pixels.assign(count * 3, 0);
+    s.sent.assign(count * 3, 0);
+    s.busyUntil = 0;
+    s.encoding = false;
+    return true;
+}
+
+void
+MockLedOutput::set(uint8_t strand, uint16_t from, const uint8_t* rgb, uint16_t count)
+{
+    Strand& s = _strands[strand - 1];
+    if (from + count > s.pixels.size() / 3) {
+        return;
+    }
+
+    if (!s.encoding) {
+        s.encoding = true;
+        s.encodeStart = _now;
+    }
+
+    memcpy(s.pixels.data() + from * 3, rgb, count * 3);
+    _now += count * _encodeNsPerPixel;
+}
+
+void
+MockLedOutput::transmit(uint8_t strand)
+{
+    Strand& s = _strands[strand - 1];
+
+    // The wire might still be busy if the caller didn't wait()
+    uint64_t start = (s.busyUntil > _now) ? s.busyUntil : _now;
+    uint16_t count = uint16_t(s.pixels.size() / 3);
+
+    Event event;
+    event.strand = strand;
+    event.pixels = count;
+    event.encodeStart = s.encoding ? s.encodeStart : _now;
+    event.encodeEnd = _now;
+    event.transmitStart = start;
+    event.transmitEnd = start + count * PixelNs + ResetNs;
+    _events.push_back(event);
+
+    s.sent = s.pixels;
+    s.busyUntil = event.transmitEnd;
+    s.encoding = false;
+
+    if (!_concurrent) {
+        _now = s.busyUntil;
+    }
+}
+
+void
+MockLedOutput::wait(uint8_t strand)
+{
+    advanceTo(_strands[strand - 1].busyUntil);
+}
+
+uint64_t
+MockLedOutput::idle() const
+{
+    uint64_t t = _now;
+    for (const Strand& s : _strands) {
+        if (s.busyUntil > t) {
+            t = s.busyUntil;
+        }
+    }
+    return t;
+}
+
+uint64_t
+MockLedOutput::overlap() const
+{
+    // For each encode, the part of it when any other strand was sending
+    uint64_t total = 0;
+    for (const Event& encode : _events) {
+        std::vector<std::pair<uint64_t, uint64_t>> busy;
+        for (const Event& transmit : _events) {
+            if (transmit.strand != encode.strand) {
+                busy.emplace_back(transmit.transmitStart, transmit.transmitEnd);
+            }
+        }
+        std::sort(busy.begin(), busy.end());
+
+        uint64_t covered = encode.encodeStart;
+        for (const auto& interval : busy) {
+            uint64_t from = std::max(covered, interval.first);
+            uint64_t to = std::min(encode.encodeEnd, interval.second);
+            if (to > from) {
+                total += to - from;
+                covered = to;
+            }
+        }
+    }
+    return total;
+}
@@ -0,0 +1,91 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// MockLedOutput Class
+//
+// LedOutput for checking strand timing on the host. Nothing is sent
+// anywhere. Instead every strand keeps its pixels and each set() and
+// transmit() is placed on a modeled timeline in ns: set() costs the CPU
+// EncodeNsPerPixel for each pixel and a transmit keeps the strand's wire
+// busy for 24 bits per pixel at WS2812 speed plus the reset time.
+//
+// Concurrent, transmit() returns right away and the CPU carries on with
+// the next strand while this one sends, like RmtLedOutput. Serial, it
+// returns when the strand is done, like SystemLedOutput. Each strand's
+// encode and transmit times are recorded as Events so a tool can see how
+// they overlap.
+
+#pragma once
+
+#include "LedOutput.h"
+#include "Topology.h"
+
+#include <stdint.h>
+#include <vector>
+
+class MockLedOutput : public LedOutput
+{
+public:
+    static constexpr uint64_t BitNs = 1250;
+    static constexpr uint64_t PixelNs = 24 * BitNs;
+    static constexpr uint64_t ResetNs = 80000;
+    static constexpr uint64_t DefaultEncodeNsPerPixel = 400;
+
+    struct Event
+    {
+        uint8_t strand;
+        uint16_t pixels;
+        uint64_t encodeStart;
+        uint64_t encodeEnd;
+        uint64_t transmitStart;
+        uint64_t transmitEnd;
+    };
+
+    MockLedOutput(bool concurrent, uint64_t encodeNsPerPixel = DefaultEncodeNsPerPixel)
+        : _concurrent(concurrent)
+        , _encodeNsPerPixel(encodeNsPerPixel)
+    { }
+
+    virtual bool begin(uint8_t strand, uint8_t pin, uint16_t count) override;
+    virtual void set(uint8_t strand, uint16_t from, const uint8_t* rgb, uint16_t count) override;
+    virtual void transmit(uint8_t strand) override;
+    virtual void wait(uint8_t strand) override;
+
+    // The CPU's place on the timeline. It never goes backwards
+    uint64_t now() const { return _now; }
+    void advanceTo(uint64_t t) { if (t > _now) _now = t; }
+
+    // When the last strand is done sending
+    uint64_t idle() const;
+
+    const std::vector<Event>& events() const { return _events; }
+    void clearEvents() { _events.clear(); }
+
+    // Time the CPU spent encoding one strand while another was sending
+    uint64_t overlap() const;
+
+    // What was last sent on a strand
+    const std::vector<uint8_t>& sent(uint8_t strand) const { return _strands[strand - 1].sent; }
+
+private:
+    struct Strand
+    {
+        std::vector<uint8_t> pixels;
+        std::vector<uint8_t> sent;
+        uint64_t busyUntil = 0;
+        uint64_t encodeStart = 0;
+        bool encoding = false;
+    };
+
+    bool _concurrent;
+    uint64_t _encodeNsPerPixel;
+    uint64_t _now = 0;
+    Strand _strands[Topology::MaxStrands];
+    std::vector<Event> _events;
+};
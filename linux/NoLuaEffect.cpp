@@ -0,0 +1,57 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Used in place of LuaEffect.cpp when Lua isn't available. Every script
+// fails to start, so sendCmd falls back to the (headless, no-op) shell.
+
+#include "LuaEffect.h"
+
+LuaEffect::LuaEffect(FrameBuffer* frameBuffer)
+    : _frameBuffer(frameBuffer)
+    , _animator(nullptr)
+{
+}
+
+LuaEffect::~LuaEffect()
+{
+}
+
+size_t
+LuaEffect::configure()
+{
+    return 0;
+}
+
+bool
+LuaEffect::init(const char*, const uint8_t*, uint16_t)
+{
+    return false;
+}
+
+int32_t
+LuaEffect::loop()
+{
+    return -1;
+}
+
+void
+LuaEffect::stop()
+{
+}
+
+void
+LuaEffect::collectIdle()
+{
+}
+
+std::string
+LuaEffect::statsString() const
+{
+    return "Lua not available";
+}
@@ -0,0 +1,172 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+#include "System.h"
+
+#include "FrameTrace.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace mil;
+
+static constexpr uint16_t MaxLEDs = 4096;
+static constexpr uint8_t MaxStrands = 8;
+
+static uint32_t currentTime = 0;
+static bool verbose = false;
+static uint16_t ledCount = 0;
+
+// Strands are kept one after the other in the LED buffers
+static uint16_t strandStart[MaxStrands] = { };
+static uint16_t strandCount[MaxStrands] = { };
+static uint8_t pending[MaxLEDs * 3];
+static uint8_t shown[MaxLEDs * 3];
+static uint32_t refreshCount = 0;
+static FrameTrace trace;
+
+uint32_t
+System::millis()
+{
+    return currentTime;
+}
+
+void
+System::delay(uint32_t ms)
+{
+    currentTime += ms;
+}
+
+static void
+log(const char* level, const char* tag, const char* format, va_list args)
+{
+    fprintf(stderr, "%s %s: ", level, tag);
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+}
+
+void
+System::logI(const char* tag, const char* format, ...)
+{
+    if (!verbose) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    log("I", tag, format, args);
+    va_end(args);
+}
+
+void
+System::logE(const char* tag, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    log("E", tag, format, args);
+    va_end(args);
+}
+
+void
+System::initLED(uint8_t strand, uint8_t, uint16_t count)
+{
+    if (strand < 1 || strand > MaxStrands) {
+        return;
+    }
+
+    // Strands are started in order, so the first one starts over
+    if (strand == 1) {
+        ledCount = 0;
+        memset(strandCount, 0, sizeof(strandCount));
+        memset(pending, 0, sizeof(pending));
+        memset(shown, 0, sizeof(shown));
+    }
+
+    if (count > MaxLEDs - ledCount) {
+        count = MaxLEDs - ledCount;
+    }
+    strandStart[strand - 1] = ledCount;
+    strandCount[strand - 1] = count;
+    ledCount += count;
+}
+
+void
+System::setLEDs(uint8_t strand, uint16_t from, uint16_t count, uint8_t r, uint8_t g, uint8_t b)
+{
+    if (strand < 1 || strand > MaxStrands) {
+        return;
+    }
+
+    uint8_t* p = pending + strandStart[strand - 1] * 3;
+    for (uint16_t i = from; i < from + count && i < strandCount[strand - 1]; ++i) {
+        p[i * 3] = r;
+        p[i * 3 + 1] = g;
+        p[i * 3 + 2] = b;
+    }
+}
+
+void
+System::refreshLEDs(uint8_t strand)
+{
+    if (strand < 1 || strand > MaxStrands) {
+        return;
+    }
+
+    uint16_t start = strandStart[strand - 1];
+    uint16_t end = start + strandCount[strand - 1];
+
+    if (trace.valid()) {
+        // Record which pixels changed along with the frame
+        uint16_t first = start;
+        uint16_t last = end;
+        while (first < end && memcmp(pending + first * 3, shown + first * 3, 3) == 0) {
+            first++;
+        }
+        while (last > first && memcmp(pending + (last - 1) * 3, shown + (last - 1) * 3, 3) == 0) {
+            last--;
+        }
+        memcpy(shown + start * 3, pending + start * 3, (end - start) * 3);
+        trace.append(uint64_t(currentTime) * 1000, shown, first, last - first);
+    } else {
+        memcpy(shown + start * 3, pending + start * 3, (end - start) * 3);
+    }
+
+    refreshCount++;
+}
+
+bool
+System::traceTo(const char* path, uint32_t frames)
+{
+    return trace.create(ledCount, frames, path);
+}
+
+void
+System::setVerbose(bool v)
+{
+    verbose = v;
+}
+
+const uint8_t*
+System::leds()
+{
+    return shown;
+}
+
+uint16_t
+System::numLEDs()
+{
+    return ledCount;
+}
+
+uint32_t
+System::refreshes()
+{
+    return refreshCount;
+}
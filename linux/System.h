@@ -0,0 +1,51 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Headless System
+//
+// Stands in for ESPlib's System in the Linux build. millis() is a
+// virtual clock which only moves when delay() is called, so effects run
+// as fast as the CPU allows rather than in real time. LEDs are kept in
+// a buffer rather than sent anywhere, with each strand after the one
+// before it, and each refresh of a strand can be recorded to a FrameTrace
+// file.
+
+#pragma once
+
+#include <stdint.h>
+
+namespace mil {
+
+class System
+{
+public:
+    static uint32_t millis();
+    static void delay(uint32_t ms);
+
+    static void logI(const char* tag, const char* format, ...);
+    static void logE(const char* tag, const char* format, ...);
+
+    static void initLED(uint8_t strand, uint8_t pin, uint16_t count);
+    static void setLEDs(uint8_t strand, uint16_t from, uint16_t count, uint8_t r, uint8_t g, uint8_t b);
+    static void refreshLEDs(uint8_t strand);
+
+    static bool isRestarting() { return false; }
+
+    // Headless only
+    static void setVerbose(bool verbose);
+    static const uint8_t* leds(); // RGB of every strand, as of its last refresh
+    static uint16_t numLEDs();
+    static uint32_t refreshes();
+
+    // Record refreshes of the LEDs from initLED() to path (see FrameTrace.h).
+    // Times in the trace are on the virtual clock
+    static bool traceTo(const char* path, uint32_t frames);
+};
+
+}
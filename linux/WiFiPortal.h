@@ -0,0 +1,49 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Headless WiFiPortal
+//
+// Stands in for ESPlib's WiFiPortal in the Linux build. There's no
+// network. Args for a request are set with setArgs() and the last
+// response is kept for the caller to look at.
+
+#pragma once
+
+#include <map>
+#include <string>
+
+namespace mil {
+
+class WiFiPortal
+{
+public:
+    void sendHTTPResponse(int code, const char*, const char* body)
+    {
+        _responseCode = code;
+        _response = body;
+    }
+
+    std::string getHTTPArg(const char* name) const
+    {
+        auto it = _args.find(name);
+        return (it == _args.end()) ? std::string() : it->second;
+    }
+
+    // Headless only
+    void setArgs(const std::map<std::string, std::string>& args) { _args = args; }
+    int responseCode() const { return _responseCode; }
+    const std::string& response() const { return _response; }
+
+private:
+    std::map<std::string, std::string> _args;
+    int _responseCode = 0;
+    std::string _response;
+};
+
+}
@@ -0,0 +1,86 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Batch parsing tool
+//
+// Parses a batch of commands (see CommandBatch.h), in text form or, with
+// -b, the binary form given as hex, and prints one JSON object per
+// command:
+//
+//      {"cmd":"C","params":[0,255,128,0,0],"firstPost":1,"numPosts":60}
+//
+// -z adds a null to the end of the body, like espidf's getHTTPArg()
+// does. Exits with 0 if the batch is valid. Usage:
+//
+//      plcbatch [-n posts] [-b] [-z] batch
+
+#include "CommandBatch.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+int main(int argc, char * const argv[])
+{
+    uint16_t posts = 60;
+    bool binary = false;
+    bool null = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:bz")) != -1) {
+        switch (opt) {
+            case 'n': posts = uint16_t(atoi(optarg)); break;
+            case 'b': binary = true; break;
+            case 'z': null = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-n posts] [-b] [-z] batch\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-n posts] [-b] [-z] batch\n", argv[0]);
+        return 1;
+    }
+
+    std::string body;
+    const char* arg = argv[optind];
+    if (binary) {
+        for (size_t i = 0; arg[i] && arg[i + 1]; i += 2) {
+            body += char(strtol(std::string(arg + i, 2).c_str(), nullptr, 16));
+        }
+    } else {
+        body = arg;
+    }
+    if (null) {
+        body += '\0';
+    }
+
+    CommandBatch batch;
+    bool parsed = binary ? batch.parseBinary(reinterpret_cast<const uint8_t*>(body.data()), body.size(), posts)
+                         : batch.parse(body, posts);
+    if (!parsed) {
+        fprintf(stderr, "invalid batch\n");
+        return 2;
+    }
+
+    for (uint8_t i = 0; i < batch.size(); ++i) {
+        const CommandBatch::Command& cmd = batch[i];
+        std::string params;
+        for (uint16_t j = 1; j < cmd.size; ++j) {
+            if (j > 1) {
+                params += ',';
+            }
+            params += std::to_string(cmd.buf[j]);
+        }
+        printf("{\"cmd\":\"%c\",\"params\":[%s],\"firstPost\":%u,\"numPosts\":%u}\n",
+               char(cmd.buf[0]), params.c_str(), cmd.firstPost + 1, cmd.numPosts);
+    }
+    return 0;
+}
@@ -0,0 +1,359 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Cross-engine effect comparison
+//
+// Runs one effect command on two engines (native, lua or clover) with
+// the same seed and args on the virtual clock, records every frame sent
+// to the lights and diffs the two streams. Frames are compared every
+// sample interval, using the frame which was showing at that time, so
+// engines don't need to refresh at the same moments. One JSON object is
+// printed per engine and one for the comparison:
+//
+//      {"engine":"native","cmd":"f,30,255,200,3","seed":1,"frames":400,
+//       "nsPerFrame":950.3,"allocsPerFrame":0.000,"heapPeak":0}
+//      {"compare":"native/lua","samples":400,"matching":400,
+//       "pixelsOver":0,"maxDiff":0,"firstDiffMs":-1}
+//
+// nsPerFrame is CPU time in the engine's loop() and the show() which
+// follows it. heapPeak is the most heap in use above what it was before
+// the effect started, sampled after each frame. Clover also prints how
+// its code was fetched (see CodeProvider.h), e.g.:
+//
+//      "code":"mapped size=3012 fetches=1203340 misses=0 hit=100%"
+//
+// Clover runs executable.clvx from the script directory, and is only
+// available when the build has Clover. A pixel is over when any channel
+// differs by more than the tolerance. Usage:
+//
+//      plccompare [-a engine] [-b engine] [-c cmd] [-s seconds]
+//                 [-t tolerance] [-r seed] [-i interval] [-d scriptDir]
+//                 [-T topology]
+//
+// -T runs with the topology in that file (see Topology.h) rather than
+// the default.
+//
+// Exits with 0 when every sample matches, 2 when they don't and 1 when
+// an engine can't run the command.
+
+#include "PostLightController.h"
+
+#include "Allocations.h"
+#include "CommandBatch.h"
+#include "FrameBuffer.h"
+#include "LuaEffect.h"
+#include "NativeEffect.h"
+#include "Topology.h"
+
+#ifdef PLC_CLOVER
+#include "CodeProvider.h"
+#include "InterpretedEffect.h"
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+class Engine
+{
+public:
+    virtual ~Engine() { }
+    virtual bool init(FrameBuffer*, const char* scriptDir, const uint8_t* cmd, uint16_t size) = 0;
+    virtual int32_t loop() = 0;
+
+    // Extra JSON members for the engine's line, starting with a comma
+    virtual std::string stats() const { return std::string(); }
+};
+
+class NativeEngine : public Engine
+{
+public:
+    virtual bool init(FrameBuffer* frameBuffer, const char*, const uint8_t* cmd, uint16_t size) override
+    {
+        _effects.configure(frameBuffer->topology());
+        _effect = _effects.find(cmd[0]);
+        return _effect && _effect->init(frameBuffer, cmd + 1, size - 1);
+    }
+
+    virtual int32_t loop() override { return _effect->loop(); }
+
+private:
+    NativeEffects _effects;
+    NativeEffect* _effect = nullptr;
+};
+
+class LuaEngine : public Engine
+{
+public:
+    virtual ~LuaEngine() { delete _lua; }
+
+    virtual bool init(FrameBuffer* frameBuffer, const char* scriptDir, const uint8_t* cmd, uint16_t size) override
+    {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%c.lua", scriptDir, char(cmd[0]));
+        _lua = new LuaEffect(frameBuffer);
+        _lua->configure();
+        return _lua->init(path, cmd + 1, size - 1);
+    }
+
+    virtual int32_t loop() override
+    {
+        _lua->collectIdle();
+        return _lua->loop();
+    }
+
+private:
+    LuaEffect* _lua = nullptr;
+};
+
+#ifdef PLC_CLOVER
+class CloverEngine : public Engine
+{
+public:
+    virtual ~CloverEngine() { delete _effect; }
+
+    virtual bool init(FrameBuffer* frameBuffer, const char* scriptDir, const uint8_t* cmd, uint16_t size) override
+    {
+        std::string path = std::string(scriptDir) + "/executable.clvx";
+        if (!_code.open(path.c_str())) {
+            return false;
+        }
+        _effect = new InterpretedEffect(frameBuffer, CodeProvider::getCodeByte, &_code);
+        return _effect->init(cmd[0], cmd + 1, size - 1);
+    }
+
+    virtual int32_t loop() override { return _effect->loop(); }
+
+    virtual std::string stats() const override { return ",\"code\":\"" + _code.statsString() + "\""; }
+
+private:
+    CodeProvider _code;
+    InterpretedEffect* _effect = nullptr;
+};
+#endif
+
+static Engine*
+makeEngine(const char* name)
+{
+    if (strcmp(name, "native") == 0) {
+        return new NativeEngine();
+    }
+    if (strcmp(name, "lua") == 0) {
+        return new LuaEngine();
+    }
+#ifdef PLC_CLOVER
+    if (strcmp(name, "clover") == 0) {
+        return new CloverEngine();
+    }
+#endif
+    return nullptr;
+}
+
+struct Recording
+{
+    bool ok = false;
+    uint32_t frames = 0;
+    double ns = 0;
+    uint64_t allocations = 0;
+    size_t heapPeak = 0;
+    std::string stats;
+
+    // Each frame that reached the lights, with the time it was shown
+    std::vector<uint32_t> times;
+    std::vector<uint8_t> leds;
+};
+
+static void
+record(Recording& rec, const Topology& topology, const char* name, const char* scriptDir, const uint8_t* cmd, uint16_t size, uint32_t seed, uint32_t seconds)
+{
+    // Room for a frame every ms, so recording doesn't allocate while the effect runs
+    uint32_t duration = seconds * 1000;
+    size_t frameSize = topology.numPixels() * 3;
+    rec.times.reserve(duration + 1);
+    rec.leds.reserve(size_t(duration + 1) * frameSize);
+
+    Engine* engine = makeEngine(name);
+    if (!engine) {
+        return;
+    }
+
+    NativeEffect::seed(seed);
+    FrameBuffer frameBuffer(topology);
+
+    size_t heapStart = Allocations::heapBytes();
+    uint32_t startTime = mil::System::millis();
+    uint32_t refreshes = mil::System::refreshes();
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t startAllocations = Allocations::count();
+    rec.ok = engine->init(&frameBuffer, scriptDir, cmd, size);
+    rec.allocations += Allocations::count() - startAllocations;
+    rec.ns += double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+    while (rec.ok) {
+        start = std::chrono::steady_clock::now();
+        startAllocations = Allocations::count();
+        int32_t delayInMs = engine->loop();
+        frameBuffer.show();
+        rec.allocations += Allocations::count() - startAllocations;
+        rec.ns += double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        rec.frames++;
+
+        size_t heap = Allocations::heapBytes();
+        if (heap > heapStart && heap - heapStart > rec.heapPeak) {
+            rec.heapPeak = heap - heapStart;
+        }
+
+        uint32_t now = mil::System::millis() - startTime;
+        if (mil::System::refreshes() != refreshes) {
+            refreshes = mil::System::refreshes();
+            rec.times.push_back(now);
+            rec.leds.insert(rec.leds.end(), mil::System::leds(), mil::System::leds() + frameSize);
+        }
+
+        if (delayInMs < 0 || now >= duration) {
+            break;
+        }
+        mil::System::delay((delayInMs > 0) ? delayInMs : 1);
+    }
+
+    rec.stats = engine->stats();
+    delete engine;
+}
+
+// The frame showing at time, or all off before the first one
+static const uint8_t*
+frameAt(const Recording& rec, uint32_t time, size_t frameSize, size_t& index)
+{
+    static const uint8_t off[Topology::MaxPixels * 3] = { };
+
+    while (index + 1 < rec.times.size() && rec.times[index + 1] <= time) {
+        index++;
+    }
+    if (rec.times.empty() || rec.times[index] > time) {
+        return off;
+    }
+    return rec.leds.data() + index * frameSize;
+}
+
+int main(int argc, char * const argv[])
+{
+    const char* engineA = "native";
+    const char* engineB = "lua";
+    const char* cmdString = "f,30,255,200,3";
+    const char* scriptDir = ScriptDir;
+    uint32_t seconds = 10;
+    uint32_t interval = 25;
+    uint32_t seed = 1;
+    int tolerance = 0;
+    Topology topology;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:b:c:s:t:r:i:d:T:")) != -1) {
+        switch (opt) {
+            case 'a': engineA = optarg; break;
+            case 'b': engineB = optarg; break;
+            case 'c': cmdString = optarg; break;
+            case 's': seconds = uint32_t(atol(optarg)); break;
+            case 't': tolerance = atoi(optarg); break;
+            case 'r': seed = uint32_t(atol(optarg)); break;
+            case 'i': interval = uint32_t(atol(optarg)); break;
+            case 'd': scriptDir = optarg; break;
+            case 'T':
+                if (!topology.load(optarg)) {
+                    fprintf(stderr, "invalid topology '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-a engine] [-b engine] [-c cmd] [-s seconds] [-t tolerance] [-r seed] [-i interval] [-d scriptDir] [-T topology]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (interval == 0) {
+        interval = 1;
+    }
+
+    uint8_t cmd[CommandBatch::MaxCmdSize];
+    int16_t size = CommandBatch::parseCmd(cmdString, strlen(cmdString), cmd, sizeof(cmd));
+    if (size < 1) {
+        fprintf(stderr, "invalid command '%s'\n", cmdString);
+        return 1;
+    }
+
+    Recording recordings[2];
+    const char* engines[2] = { engineA, engineB };
+
+    for (int i = 0; i < 2; ++i) {
+        Recording& rec = recordings[i];
+        record(rec, topology, engines[i], scriptDir, cmd, uint16_t(size), seed, seconds);
+
+        if (!rec.ok) {
+            printf("{\"engine\":\"%s\",\"cmd\":\"%s\",\"error\":\"not available\"}\n", engines[i], cmdString);
+            continue;
+        }
+
+        printf("{\"engine\":\"%s\",\"cmd\":\"%s\",\"seed\":%u,\"frames\":%u,\"nsPerFrame\":%.1f,\"allocsPerFrame\":%.3f,\"heapPeak\":%zu%s}\n",
+               engines[i], cmdString, seed, rec.frames,
+               rec.frames ? (rec.ns / rec.frames) : 0.0,
+               rec.frames ? (double(rec.allocations) / rec.frames) : 0.0, rec.heapPeak, rec.stats.c_str());
+    }
+
+    if (!recordings[0].ok || !recordings[1].ok) {
+        return 1;
+    }
+
+    uint32_t samples = 0;
+    uint32_t matching = 0;
+    uint64_t pixelsOver = 0;
+    int maxDiff = 0;
+    int64_t firstDiff = -1;
+    size_t indexA = 0;
+    size_t indexB = 0;
+
+    for (uint32_t time = 0; time < seconds * 1000; time += interval) {
+        const uint8_t* a = frameAt(recordings[0], time, topology.numPixels() * 3, indexA);
+        const uint8_t* b = frameAt(recordings[1], time, topology.numPixels() * 3, indexB);
+        bool match = true;
+
+        for (uint16_t pixel = 0; pixel < topology.numPixels(); ++pixel) {
+            bool over = false;
+            for (uint8_t channel = 0; channel < 3; ++channel) {
+                int diff = abs(int(a[pixel * 3 + channel]) - int(b[pixel * 3 + channel]));
+                if (diff > maxDiff) {
+                    maxDiff = diff;
+                }
+                if (diff > tolerance) {
+                    over = true;
+                }
+            }
+            if (over) {
+                pixelsOver++;
+                match = false;
+            }
+        }
+
+        samples++;
+        if (match) {
+            matching++;
+        } else if (firstDiff < 0) {
+            firstDiff = time;
+        }
+    }
+
+    printf("{\"compare\":\"%s/%s\",\"samples\":%u,\"matching\":%u,\"pixelsOver\":%llu,\"maxDiff\":%d,\"firstDiffMs\":%lld}\n",
+           engineA, engineB, samples, matching, (unsigned long long) pixelsOver, maxDiff, (long long) firstDiff);
+
+    return (matching == samples) ? 0 : 2;
+}
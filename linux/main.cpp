@@ -0,0 +1,130 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Headless effect benchmark
+//
+// Runs PostLightController with no window, no network and a virtual
+// clock. Each effect is started with a /command request and run for
+// a number of simulated seconds as fast as possible. One JSON object
+// per effect is printed to stdout, for tracking changes between versions:
+//
+//      {"effect":"f","cmd":"f,30,255,200,3","seconds":60,"frames":2400,
+//       "fps":123456.7,"nsPerFrame":8100.2,"allocsPerFrame":0.000}
+//
+// fps is simulated frames per second of real (CPU) time. When the build
+// has Clover, code fetches for the effect (see CodeProvider.h) are added:
+//
+//      "code":"mapped size=3012 fetches=0 misses=0 hit=0%"
+//
+// Usage:
+//
+//      plcbench [-s seconds] [-e effect] [-v] [-o trace] [-f frames] [-F fade]
+//
+// -e runs just the effect with that command char, -v shows log messages.
+// -o records the last frames (65536 by default) sent to the lights to a
+// trace file which plctrace can decode or summarize. -F crossfades from
+// each effect to the next over fade ms (see Transition.h).
+
+#include "PostLightController.h"
+
+#include "Allocations.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+struct Benchmark
+{
+    const char* effect;
+    const char* cmd;
+};
+
+static const Benchmark benchmarks[ ] =
+{
+    { "C", "C,0,255,200,10,5" },
+    { "f", "f,30,255,200,3" },
+    { "m", "m,0,255,200,85,255,200,170,255,200,40,255,200,2" },
+    { "p", "p,85,255,255,7" },
+    { "r", "r,0,255,255,5,7" },
+};
+
+int main(int argc, char * const argv[])
+{
+    uint32_t seconds = 60;
+    const char* only = nullptr;
+    const char* tracePath = nullptr;
+    uint32_t traceFrames = 65536;
+    std::string fade = "0";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:e:vo:f:F:")) != -1) {
+        switch (opt) {
+            case 's': seconds = uint32_t(atol(optarg)); break;
+            case 'e': only = optarg; break;
+            case 'v': mil::System::setVerbose(true); break;
+            case 'o': tracePath = optarg; break;
+            case 'f': traceFrames = uint32_t(atol(optarg)); break;
+            case 'F': fade = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-s seconds] [-e effect] [-v] [-o trace] [-f frames] [-F fade]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    mil::WiFiPortal portal;
+    PostLightController controller(&portal);
+    controller.setup();
+
+    if (tracePath && !mil::System::traceTo(tracePath, traceFrames)) {
+        fprintf(stderr, "can't create trace '%s'\n", tracePath);
+        return 1;
+    }
+
+    for (const Benchmark& benchmark : benchmarks) {
+        if (only && only[0] != benchmark.effect[0]) {
+            continue;
+        }
+
+        if (!controller.request("/command", { { "cmd", benchmark.cmd }, { "fade", fade } })) {
+            fprintf(stderr, "no /command handler\n");
+            return 1;
+        }
+
+#ifdef PLC_CLOVER
+        controller.codeProvider().clearStats();
+#endif
+
+        uint32_t endTime = mil::System::millis() + seconds * 1000;
+        uint64_t frames = 0;
+        uint64_t startAllocations = Allocations::count();
+        auto startTime = std::chrono::steady_clock::now();
+
+        while (int32_t(mil::System::millis() - endTime) < 0) {
+            controller.loop();
+            frames++;
+        }
+
+        double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count());
+        uint64_t frameAllocations = Allocations::count() - startAllocations;
+
+        std::string code;
+#ifdef PLC_CLOVER
+        code = ",\"code\":\"" + controller.codeProvider().statsString() + "\"";
+#endif
+
+        printf("{\"effect\":\"%s\",\"cmd\":\"%s\",\"seconds\":%u,\"frames\":%llu,\"fps\":%.1f,\"nsPerFrame\":%.1f,\"allocsPerFrame\":%.3f%s}\n",
+               benchmark.effect, benchmark.cmd, seconds, (unsigned long long) frames,
+               ns ? (frames * 1e9 / ns) : 0.0, frames ? (ns / frames) : 0.0,
+               frames ? (double(frameAllocations) / frames) : 0.0, code.c_str());
+    }
+
+    return 0;
+}
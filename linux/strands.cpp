@@ -0,0 +1,178 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Strand timing tool
+//
+// Runs a native effect on a multi-strand topology with MockLedOutput (see
+// MockLedOutput.h) and shows how long getting each frame onto the lights
+// takes when strands are refreshed one after another and when they're
+// refreshed concurrently. One JSON object is printed per mode, then the
+// speedup:
+//
+//      {"mode":"serial","strands":4,"pixels":1920,"frames":401,
+//       "showUs":58687.9,"maxFps":17.0,"overlapUs":0.0}
+//      {"mode":"concurrent","strands":4,"pixels":1920,"frames":401,
+//       "showUs":15247.9,"maxFps":65.6,"overlapUs":575.9}
+//      {"speedup":3.85,"match":true}
+//
+// showUs is the average time from the start of show() until the last
+// strand is done sending, maxFps the frame rate that allows. overlapUs is
+// the average time per frame spent filling one strand while another was
+// sending. match says whether both modes sent the same pixels. Usage:
+//
+//      plcstrands [-n strands] [-p posts] [-x pixelsPerPost] [-c cmd]
+//                 [-s seconds] [-e encodeNsPerPixel] [-T topology]
+//
+// The posts are split evenly across the strands unless -T gives a
+// topology file (see Topology.h).
+
+#include "CommandBatch.h"
+#include "FrameBuffer.h"
+#include "MockLedOutput.h"
+#include "NativeEffect.h"
+#include "System.h"
+#include "Topology.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+struct Timing
+{
+    bool ok = false;
+    uint32_t frames = 0;
+    uint64_t showNs = 0;
+    uint64_t overlapNs = 0;
+    std::vector<uint8_t> sent;
+};
+
+static void
+run(Timing& timing, const Topology& topology, bool concurrent, uint64_t encodeNs, const uint8_t* cmd, uint16_t size, uint32_t seconds)
+{
+    MockLedOutput output(concurrent, encodeNs);
+    FrameBuffer frameBuffer(topology, &output);
+
+    NativeEffects effects;
+    effects.configure(topology);
+    NativeEffect* effect = effects.find(cmd[0]);
+
+    NativeEffect::seed(1);
+    timing.ok = effect && effect->init(&frameBuffer, cmd + 1, size - 1);
+
+    uint32_t startTime = mil::System::millis();
+    while (timing.ok) {
+        int32_t delayInMs = effect->loop();
+
+        // The mock's timeline follows the virtual clock. When the lights
+        // can't keep up, each frame starts once the last one is out so
+        // it's timed on its own
+        uint32_t now = mil::System::millis() - startTime;
+        output.advanceTo(uint64_t(now) * 1000000);
+        output.advanceTo(output.idle());
+        output.clearEvents();
+
+        uint64_t start = output.now();
+        frameBuffer.show();
+        if (!output.events().empty()) {
+            timing.showNs += output.idle() - start;
+            timing.overlapNs += output.overlap();
+            timing.frames++;
+        }
+
+        if (delayInMs < 0 || now >= seconds * 1000) {
+            break;
+        }
+        mil::System::delay((delayInMs > 0) ? delayInMs : 1);
+    }
+
+    for (uint8_t s = 1; s <= topology.numStrands(); ++s) {
+        timing.sent.insert(timing.sent.end(), output.sent(s).begin(), output.sent(s).end());
+    }
+}
+
+int main(int argc, char * const argv[])
+{
+    uint32_t strands = 4;
+    uint32_t posts = 240;
+    uint32_t pixelsPerPost = 8;
+    const char* cmdString = "f,30,255,200,3";
+    uint32_t seconds = 10;
+    uint64_t encodeNs = MockLedOutput::DefaultEncodeNsPerPixel;
+    const char* topologyPath = nullptr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:x:c:s:e:T:")) != -1) {
+        switch (opt) {
+            case 'n': strands = uint32_t(atol(optarg)); break;
+            case 'p': posts = uint32_t(atol(optarg)); break;
+            case 'x': pixelsPerPost = uint32_t(atol(optarg)); break;
+            case 'c': cmdString = optarg; break;
+            case 's': seconds = uint32_t(atol(optarg)); break;
+            case 'e': encodeNs = uint64_t(atoll(optarg)); break;
+            case 'T': topologyPath = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-n strands] [-p posts] [-x pixelsPerPost] [-c cmd] [-s seconds] [-e encodeNsPerPixel] [-T topology]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    // Split the posts evenly, with any left over on the first strands
+    Topology topology;
+    if (topologyPath) {
+        if (!topology.load(topologyPath)) {
+            fprintf(stderr, "invalid topology '%s'\n", topologyPath);
+            return 1;
+        }
+    } else {
+        if (strands == 0) {
+            strands = 1;
+        }
+        std::string text = "posts " + std::to_string(posts) + "\npixelsPerPost " + std::to_string(pixelsPerPost) + "\n";
+        for (uint32_t i = 0; i < strands; ++i) {
+            uint32_t n = posts / strands + ((i < posts % strands) ? 1 : 0);
+            text += "strand " + std::to_string(Topology::DefaultPin + i) + " " + std::to_string(n) + "\n";
+        }
+        if (!topology.parse(text.c_str(), text.size())) {
+            fprintf(stderr, "invalid topology: %u strands of %u posts of %u pixels\n", strands, posts, pixelsPerPost);
+            return 1;
+        }
+    }
+
+    uint8_t cmd[CommandBatch::MaxCmdSize];
+    int16_t size = CommandBatch::parseCmd(cmdString, strlen(cmdString), cmd, sizeof(cmd));
+    if (size < 1) {
+        fprintf(stderr, "invalid command '%s'\n", cmdString);
+        return 1;
+    }
+
+    Timing timings[2];
+    const char* modes[2] = { "serial", "concurrent" };
+
+    for (int i = 0; i < 2; ++i) {
+        Timing& timing = timings[i];
+        run(timing, topology, i == 1, encodeNs, cmd, uint16_t(size), seconds);
+        if (!timing.ok) {
+            fprintf(stderr, "'%s' is not a native effect\n", cmdString);
+            return 1;
+        }
+
+        double showUs = timing.frames ? (timing.showNs / 1000.0 / timing.frames) : 0.0;
+        printf("{\"mode\":\"%s\",\"strands\":%u,\"pixels\":%u,\"frames\":%u,\"showUs\":%.1f,\"maxFps\":%.1f,\"overlapUs\":%.1f}\n",
+               modes[i], topology.numStrands(), topology.numPixels(), timing.frames, showUs,
+               showUs ? (1e6 / showUs) : 0.0,
+               timing.frames ? (timing.overlapNs / 1000.0 / timing.frames) : 0.0);
+    }
+
+    double speedup = timings[1].showNs ? (double(timings[0].showNs) / timings[1].showNs) : 0.0;
+    printf("{\"speedup\":%.2f,\"match\":%s}\n", speedup, (timings[0].sent == timings[1].sent) ? "true" : "false");
+    return 0;
+}
@@ -0,0 +1,241 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Pixel stream tool
+//
+// Streams frames to a PixelStream (see PixelStream.h) over UDP on
+// loopback, the way a host sending DDP would, and checks what reaches the
+// lights through MockLedOutput. Some packets can be left out and some
+// sent out of order to see that they're counted as dropped and late.
+// Every burstEvery frames two are sent before either is taken, to see
+// that the first isn't torn by the second. Once the frames are sent it waits out the stream's timeout on the
+// virtual clock. One JSON object is printed:
+//
+//      {"frames":200,"packets":1168,"shown":195,"intact":137,
+//       "dropped":32,"expectedDropped":32,"late":33,"expectedLate":33,
+//       "receiveUs":14.0,"timedOut":true,"ok":true}
+//
+// shown is the number of frames the stream showed and intact how many of
+// those reached the lights exactly as sent. Frames missing a packet, or
+// with one late, aren't expected to be intact. receiveUs is the average
+// time loop() took to receive and show a frame. Exits with 0 when the
+// counts are as expected, every untouched frame was intact and the stream
+// timed out. Usage:
+//
+//      plcstream [-n posts] [-x pixelsPerPost] [-f frames] [-b bytesPerPacket]
+//                [-d dropEvery] [-l lateEvery] [-k burstEvery] [-p port]
+
+#include "FrameBuffer.h"
+#include "FrameClock.h"
+#include "MockLedOutput.h"
+#include "PixelStream.h"
+#include "System.h"
+#include "Topology.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static uint64_t
+realNs()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// A frame which is different every time, so a stale pixel shows
+static void
+makeFrame(std::vector<uint8_t>& frame, uint32_t n)
+{
+    for (size_t i = 0; i < frame.size(); ++i) {
+        frame[i] = uint8_t(i * 7 + n * 13 + (i / 3) * n);
+    }
+}
+
+int main(int argc, char * const argv[])
+{
+    uint32_t posts = 60;
+    uint32_t pixelsPerPost = 8;
+    uint32_t frames = 200;
+    uint32_t bytesPerPacket = 240;
+    uint32_t dropEvery = 37;
+    uint32_t lateEvery = 23;
+    uint32_t burstEvery = 5;
+    uint16_t port = 14048;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:x:f:b:d:l:k:p:")) != -1) {
+        switch (opt) {
+            case 'n': posts = uint32_t(atol(optarg)); break;
+            case 'x': pixelsPerPost = uint32_t(atol(optarg)); break;
+            case 'f': frames = uint32_t(atol(optarg)); break;
+            case 'b': bytesPerPacket = uint32_t(atol(optarg)); break;
+            case 'd': dropEvery = uint32_t(atol(optarg)); break;
+            case 'l': lateEvery = uint32_t(atol(optarg)); break;
+            case 'k': burstEvery = uint32_t(atol(optarg)); break;
+            case 'p': port = uint16_t(atoi(optarg)); break;
+            default:
+                fprintf(stderr, "usage: %s [-n posts] [-x pixelsPerPost] [-f frames] [-b bytesPerPacket] [-d dropEvery] [-l lateEvery] [-k burstEvery] [-p port]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    Topology topology;
+    std::string text = "posts " + std::to_string(posts) + "\npixelsPerPost " + std::to_string(pixelsPerPost)
+                     + "\nstrand " + std::to_string(Topology::DefaultPin) + " " + std::to_string(posts) + "\n";
+    if (!topology.parse(text.c_str(), text.size()) || bytesPerPacket == 0 || bytesPerPacket > 1440) {
+        fprintf(stderr, "invalid setup: %u posts of %u pixels, %u bytes per packet\n", posts, pixelsPerPost, bytesPerPacket);
+        return 1;
+    }
+
+    MockLedOutput output(true);
+    FrameBuffer frameBuffer(topology, &output);
+    FrameClock frameClock;
+    PixelStream stream(&frameClock);
+    if (!stream.begin(port)) {
+        fprintf(stderr, "can't listen on port %d\n", int(port));
+        return 1;
+    }
+
+    int sender = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in to = { };
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &to.sin_addr);
+
+    std::vector<uint8_t> frame(topology.numPixels() * 3);
+    uint32_t seq = 0;
+    uint32_t dropCount = 0;
+    uint32_t lateCount = 0;
+    uint32_t expectedDropped = 0;
+    uint32_t expectedLate = 0;
+    uint32_t shown = 0;
+    uint32_t intact = 0;
+    uint32_t untouched = 0;
+    uint64_t receiveNs = 0;
+    bool ok = true;
+
+    // Sends frame n and returns true if none of it was left out or sent late
+    auto send = [&](uint32_t n)
+    {
+        makeFrame(frame, n);
+
+        // Split the frame into numbered packets, the last one pushing it
+        std::vector<std::vector<uint8_t>> packets;
+        for (uint32_t offset = 0; offset < frame.size(); offset += bytesPerPacket) {
+            uint32_t length = (offset + bytesPerPacket <= frame.size()) ? bytesPerPacket : uint32_t(frame.size()) - offset;
+            seq = seq % 15 + 1;
+            bool last = offset + length == frame.size();
+            std::vector<uint8_t> packet = {
+                uint8_t(0x40 | (last ? 0x01 : 0)), uint8_t(seq), 0x0b, 1,
+                uint8_t(offset >> 24), uint8_t(offset >> 16), uint8_t(offset >> 8), uint8_t(offset),
+                uint8_t(length >> 8), uint8_t(length)
+            };
+            packet.insert(packet.end(), frame.begin() + offset, frame.begin() + offset + length);
+            packets.push_back(packet);
+        }
+
+        // Leave some out, then send some of the rest after the one following
+        // them. The last packet of a frame is never late, so frames are
+        // shown in order
+        std::vector<std::vector<uint8_t>> sent;
+        bool touched = false;
+        for (std::vector<uint8_t>& packet : packets) {
+            if (dropEvery && ++dropCount % dropEvery == 0) {
+                expectedDropped++;
+                touched = true;
+                continue;
+            }
+            sent.push_back(packet);
+        }
+        for (size_t i = 0; lateEvery && i + 2 < sent.size(); ++i) {
+            if (++lateCount % lateEvery == 0) {
+                std::swap(sent[i], sent[i + 1]);
+                expectedLate++;
+                touched = true;
+                ++i;
+            }
+        }
+        for (const std::vector<uint8_t>& packet : sent) {
+            sendto(sender, packet.data(), packet.size(), 0, reinterpret_cast<sockaddr*>(&to), sizeof(to));
+        }
+        return !touched;
+    };
+
+    // Takes the next frame like the frame loop would and checks it's frame n
+    auto receive = [&](uint32_t n, bool untouchedFrame)
+    {
+        // Give the listener a moment to see the packets
+        uint32_t frameCount = stream.stats().frames;
+        for (int tries = 0; tries < 50 && stream.stats().frames == frameCount; ++tries) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            uint64_t start = realNs();
+            PixelStream::State state = stream.loop(frameBuffer);
+            if (state == PixelStream::State::Started) {
+                frameBuffer.clear();
+                stream.loop(frameBuffer);
+            }
+            receiveNs += realNs() - start;
+        }
+        if (stream.stats().frames == frameCount) {
+            return;
+        }
+
+        shown++;
+        makeFrame(frame, n);
+        bool same = output.sent(1) == frame;
+        if (same) {
+            intact++;
+        }
+        if (untouchedFrame) {
+            untouched++;
+            if (!same) {
+                ok = false;
+            }
+        }
+    };
+
+    for (uint32_t n = 0; n < frames; ++n) {
+        // Now and then send two frames before taking either, like a host
+        // which is ahead of the frame loop
+        if (burstEvery && n % burstEvery == burstEvery - 1 && n + 1 < frames) {
+            bool first = send(n);
+            bool second = send(n + 1);
+            receive(n, first);
+            receive(n + 1, second);
+            ++n;
+        } else {
+            receive(n, send(n));
+        }
+
+        mil::System::delay(25);
+    }
+
+    // Nothing more is coming, so the stream should end
+    mil::System::delay(PixelStream::Timeout);
+    bool timedOut = stream.loop(frameBuffer) == PixelStream::State::TimedOut;
+
+    const PixelStream::Stats& stats = stream.stats();
+    ok = ok && timedOut && stats.dropped == expectedDropped && stats.late == expectedLate && untouched > 0;
+
+    printf("{\"frames\":%u,\"packets\":%u,\"shown\":%u,\"intact\":%u,\"dropped\":%u,\"expectedDropped\":%u,"
+           "\"late\":%u,\"expectedLate\":%u,\"receiveUs\":%.1f,\"timedOut\":%s,\"ok\":%s}\n",
+           frames, stats.packets, shown, intact, stats.dropped, expectedDropped, stats.late, expectedLate,
+           shown ? (receiveNs / 1000.0 / shown) : 0.0, timedOut ? "true" : "false", ok ? "true" : "false");
+
+    close(sender);
+    return ok ? 0 : 2;
+}
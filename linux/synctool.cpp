@@ -0,0 +1,227 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Clock sync tool
+//
+// Runs a SyncClock master and several followers (see SyncClock.h) in one
+// process, talking over UDP on loopback. Each has its own local clock,
+// started at a random offset and running fast or slow by a random number
+// of ppm. Followers have their own thread which services them every
+// interval ms, like the controller's frame loop does. Every 100ms each
+// follower's time is compared with the master's. Once a follower locks,
+// the error is recorded. trackedSkewPpm is how much faster the follower
+// thinks the master runs, so it should come out near -skewPpm. One JSON
+// object is printed per follower, then a summary:
+//
+//      {"follower":3,"offsetMs":-2036.2,"skewPpm":96.5,"lockMs":100,
+//       "meanErrorUs":49.5,"maxErrorUs":259,"jitterUs":64.0,
+//       "reportedJitterUs":27,"trackedSkewPpm":-96.3,"rttUs":41,
+//       "replies":40,"lost":0}
+//      {"followers":3,"maxErrorUs":259,"limitUs":1000,"skewLimitPpm":5.0,
+//       "ok":true}
+//
+// Errors are followers' time minus the master's. jitterUs is their
+// standard deviation. Exits with 0 when every follower locked, stayed
+// within limitUs and tracked its skew to within skewLimitPpm. Usage:
+//
+//      plcsync [-n followers] [-s seconds] [-p port] [-k skewPpm]
+//              [-o offsetMs] [-i interval] [-t limitUs] [-e skewLimitPpm]
+//              [-r seed]
+
+#include "SyncClock.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+static uint64_t
+realMicros()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// A local clock which started offsetUs from real time and runs skewPpm
+// fast. Its thread holds the mutex while servicing it
+class TestClock : public SyncClock
+{
+public:
+    std::mutex mutex;
+
+    TestClock(uint64_t start, int64_t offsetUs, double skewPpm)
+        : _start(start)
+        , _offsetUs(offsetUs)
+        , _skewPpm(skewPpm)
+    { }
+
+    // Stop the clock's thread while localMicros() is still ours
+    virtual ~TestClock() { end(); }
+
+protected:
+    virtual uint64_t localMicros() const override
+    {
+        uint64_t elapsed = realMicros() - _start;
+        return uint64_t(int64_t(1000000000) + int64_t(elapsed) + int64_t(double(elapsed) * _skewPpm / 1e6) + _offsetUs);
+    }
+
+private:
+    uint64_t _start;
+    int64_t _offsetUs;
+    double _skewPpm;
+};
+
+struct Follower
+{
+    TestClock* clock;
+    int64_t offsetUs;
+    double skewPpm;
+    int64_t lockMs = -1;
+    std::vector<int64_t> errors;
+};
+
+// Uniform from -range to range
+static double
+random(uint32_t& seed, double range)
+{
+    seed = seed * 1103515245 + 12345;
+    return (double((seed >> 8) & 0xffff) / 0xffff * 2 - 1) * range;
+}
+
+int main(int argc, char * const argv[])
+{
+    uint32_t numFollowers = 3;
+    uint32_t seconds = 20;
+    uint16_t port = 14210;
+    double maxSkew = 100;
+    double maxOffset = 5000;
+    uint32_t interval = 5;
+    int64_t limit = 1000;
+    double skewLimit = 5;
+    uint32_t seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:p:k:o:i:t:e:r:")) != -1) {
+        switch (opt) {
+            case 'n': numFollowers = uint32_t(atol(optarg)); break;
+            case 's': seconds = uint32_t(atol(optarg)); break;
+            case 'p': port = uint16_t(atoi(optarg)); break;
+            case 'k': maxSkew = atof(optarg); break;
+            case 'o': maxOffset = atof(optarg); break;
+            case 'i': interval = uint32_t(atol(optarg)); break;
+            case 't': limit = atoll(optarg); break;
+            case 'e': skewLimit = atof(optarg); break;
+            case 'r': seed = uint32_t(atol(optarg)); break;
+            default:
+                fprintf(stderr, "usage: %s [-n followers] [-s seconds] [-p port] [-k skewPpm] [-o offsetMs] [-i interval] [-t limitUs] [-e skewLimitPpm] [-r seed]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    uint64_t start = realMicros();
+
+    TestClock master(start, 0, 0);
+    if (!master.begin(SyncClock::Role::Master, nullptr, port)) {
+        fprintf(stderr, "can't start the master on port %d\n", int(port));
+        return 1;
+    }
+
+    std::vector<Follower> followers(numFollowers);
+    for (Follower& follower : followers) {
+        follower.offsetUs = int64_t(random(seed, maxOffset) * 1000);
+        follower.skewPpm = random(seed, maxSkew);
+        follower.clock = new TestClock(start, follower.offsetUs, follower.skewPpm);
+        if (!follower.clock->begin(SyncClock::Role::Follower, "127.0.0.1", port)) {
+            fprintf(stderr, "can't start a follower\n");
+            return 1;
+        }
+    }
+
+    uint64_t end = start + uint64_t(seconds) * 1000000;
+    auto service = [end, interval](TestClock* clock)
+    {
+        while (realMicros() < end) {
+            {
+                std::lock_guard<std::mutex> lock(clock->mutex);
+                clock->loop();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (Follower& follower : followers) {
+        threads.emplace_back(service, follower.clock);
+    }
+
+    // Compare each follower with the master
+    for (uint64_t now = start; now < end; now = realMicros()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        for (Follower& follower : followers) {
+            std::lock_guard<std::mutex> masterLock(master.mutex);
+            std::lock_guard<std::mutex> followerLock(follower.clock->mutex);
+            if (!follower.clock->locked()) {
+                continue;
+            }
+            if (follower.lockMs < 0) {
+                follower.lockMs = int64_t(realMicros() - start) / 1000;
+            }
+            follower.errors.push_back(int64_t(follower.clock->micros() - master.micros()));
+        }
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    int64_t maxError = 0;
+    bool ok = true;
+
+    for (size_t i = 0; i < followers.size(); ++i) {
+        Follower& follower = followers[i];
+        double mean = 0;
+        int64_t followerMax = 0;
+        for (int64_t error : follower.errors) {
+            mean += double(error);
+            if (std::llabs(error) > followerMax) {
+                followerMax = std::llabs(error);
+            }
+        }
+        mean = follower.errors.empty() ? 0 : mean / follower.errors.size();
+
+        double variance = 0;
+        for (int64_t error : follower.errors) {
+            variance += (double(error) - mean) * (double(error) - mean);
+        }
+        double jitter = follower.errors.empty() ? 0 : std::sqrt(variance / follower.errors.size());
+
+        const SyncClock::Stats& stats = follower.clock->stats();
+        printf("{\"follower\":%zu,\"offsetMs\":%.1f,\"skewPpm\":%.1f,\"lockMs\":%lld,\"meanErrorUs\":%.1f,\"maxErrorUs\":%lld,"
+               "\"jitterUs\":%.1f,\"reportedJitterUs\":%u,\"trackedSkewPpm\":%.1f,\"rttUs\":%u,\"replies\":%u,\"lost\":%u}\n",
+               i + 1, follower.offsetUs / 1000.0, follower.skewPpm, (long long) follower.lockMs, mean, (long long) followerMax,
+               jitter, stats.jitter, double(stats.skew), stats.rtt, stats.replies, stats.lost);
+
+        if (followerMax > maxError) {
+            maxError = followerMax;
+        }
+        // The tracked skew is the master's rate against ours, so it's
+        // the follower's turned around
+        if (follower.lockMs < 0 || followerMax > limit || std::fabs(double(stats.skew) + follower.skewPpm) > skewLimit) {
+            ok = false;
+        }
+        delete follower.clock;
+    }
+
+    printf("{\"followers\":%u,\"maxErrorUs\":%lld,\"limitUs\":%lld,\"skewLimitPpm\":%.1f,\"ok\":%s}\n",
+           numFollowers, (long long) maxError, (long long) limit, skewLimit, ok ? "true" : "false");
+    return ok ? 0 : 2;
+}
@@ -0,0 +1,119 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Frame trace tool
+//
+// Decodes or summarizes a trace made by plcbench -o or the host NeoPixel
+// (see FrameTrace.h). By default prints a JSON summary of the frames
+// still in the trace:
+//
+//      {"pixels":56,"capacity":65536,"frames":2400,"available":2400,
+//       "durationMs":59975.0,"fps":40.0,"minIntervalMs":25.0,
+//       "maxIntervalMs":25.0,"changedPerFrame":55.2}
+//
+// -d dumps frames instead, one per line as the time in us, the first
+// changed pixel, the number changed and the RGB of those pixels in hex.
+// -n limits the dump to the last count frames. Usage:
+//
+//      plctrace [-d] [-n count] trace
+
+#include "FrameTrace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+static void
+dump(const FrameTrace& trace, uint32_t count)
+{
+    uint32_t available = trace.available();
+    uint32_t from = (count && count < available) ? available - count : 0;
+
+    for (uint32_t i = from; i < available; ++i) {
+        const FrameTrace::Record* record = trace.record(i);
+        const uint8_t* rgb = FrameTrace::pixels(record);
+
+        printf("%llu %u %u ", (unsigned long long) record->time, record->first, record->count);
+        for (uint32_t p = 0; p < uint32_t(record->count) * 3; ++p) {
+            printf("%02x", rgb[p]);
+        }
+        printf("\n");
+    }
+}
+
+static void
+summarize(const FrameTrace& trace)
+{
+    uint32_t available = trace.available();
+    uint64_t changed = 0;
+    uint64_t minInterval = UINT64_MAX;
+    uint64_t maxInterval = 0;
+
+    for (uint32_t i = 0; i < available; ++i) {
+        const FrameTrace::Record* record = trace.record(i);
+        changed += record->count;
+
+        if (i > 0) {
+            uint64_t interval = record->time - trace.record(i - 1)->time;
+            if (interval < minInterval) {
+                minInterval = interval;
+            }
+            if (interval > maxInterval) {
+                maxInterval = interval;
+            }
+        }
+    }
+
+    uint64_t duration = (available > 1) ? trace.record(available - 1)->time - trace.record(0)->time : 0;
+    if (minInterval == UINT64_MAX) {
+        minInterval = 0;
+    }
+
+    printf("{\"pixels\":%u,\"capacity\":%u,\"frames\":%llu,\"available\":%u,\"durationMs\":%.1f,\"fps\":%.1f,"
+           "\"minIntervalMs\":%.1f,\"maxIntervalMs\":%.1f,\"changedPerFrame\":%.1f}\n",
+           trace.numPixels(), trace.capacity(), (unsigned long long) trace.frames(), available,
+           duration / 1000.0, duration ? ((available - 1) * 1e6 / duration) : 0.0,
+           minInterval / 1000.0, maxInterval / 1000.0,
+           available ? (double(changed) / available) : 0.0);
+}
+
+int main(int argc, char * const argv[])
+{
+    bool dumpFrames = false;
+    uint32_t count = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "dn:")) != -1) {
+        switch (opt) {
+            case 'd': dumpFrames = true; break;
+            case 'n': count = uint32_t(atol(optarg)); break;
+            default:
+                fprintf(stderr, "usage: %s [-d] [-n count] trace\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-d] [-n count] trace\n", argv[0]);
+        return 1;
+    }
+
+    FrameTrace trace;
+    if (!trace.open(argv[optind])) {
+        fprintf(stderr, "'%s' is not a frame trace\n", argv[optind]);
+        return 1;
+    }
+
+    if (dumpFrames) {
+        dump(trace, count);
+    } else {
+        summarize(trace);
+    }
+    return 0;
+}
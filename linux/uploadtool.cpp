@@ -0,0 +1,171 @@
+/*-------------------------------------------------------------------------
+    This source file is a part of PostLightController
+    For the latest info, see https://github.com/cmarrin/PostLightController
+    Copyright (c) 2021-2025, Chris Marrin
+    All rights reserved.
+    Use of this source code is governed by the MIT license that can be
+    found in the LICENSE file.
+-------------------------------------------------------------------------*/
+
+// Incremental upload tool
+//
+// Makes the serial packets which upload an EEPROM image to the Arduino
+// chain (see PostLightController.ino), sending only the 64 byte pages
+// which have changed. The chain has no return path, so the hashes of
+// what a device has come from its console. -q prints the 'H' packet
+// which asks for them:
+//
+//      plcupload -q image > /dev/ttyUSB0
+//
+// and the device prints one "H page hash" line per page. Given those
+// lines in a file, a 'W' packet is made for each page whose Fletcher-16
+// hash differs from the image's:
+//
+//      plcupload -h hashes.txt image > /dev/ttyUSB0
+//
+// Without -h every page is sent. Pages the hashes don't mention are sent
+// too. Packets use CRC framing and go to address 0 (every device) unless
+// -a says otherwise. They're written to stdout, and the sender must pace
+// them for SoftwareSerial. A summary goes to stderr:
+//
+//      pages=16 changed=3 bytes=219
+//
+// Usage:
+//
+//      plcupload [-a address] [-q] [-h hashes] image
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static constexpr size_t PageSize = 64;
+static constexpr char CRCStartChar = '[';
+static constexpr char CRCEndChar = ']';
+
+// CRC-8, polynomial 0x07, initial value 0, as the .ino checks it
+static uint8_t
+crc8(uint8_t crc, uint8_t c)
+{
+    crc ^= c;
+    for (int i = 0; i < 8; ++i) {
+        crc = (crc & 0x80) ? uint8_t((crc << 1) ^ 0x07) : uint8_t(crc << 1);
+    }
+    return crc;
+}
+
+static uint16_t
+pageHash(const std::vector<uint8_t>& image, size_t page)
+{
+    // Fletcher-16
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (size_t i = page * PageSize; i < (page + 1) * PageSize; ++i) {
+        sum1 = (sum1 + image[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return uint16_t((sum2 << 8) | sum1);
+}
+
+static void
+appendPacket(std::string& out, char addr, char cmd, const std::vector<uint8_t>& payload)
+{
+    std::string packet = { CRCStartChar, addr, cmd, char(payload.size() >> 8), char(payload.size() & 0xff) };
+    packet.append(payload.begin(), payload.end());
+
+    uint8_t crc = 0;
+    for (char c : packet) {
+        crc = crc8(crc, uint8_t(c));
+    }
+    packet += char(crc);
+    packet += CRCEndChar;
+    out += packet;
+}
+
+int main(int argc, char * const argv[])
+{
+    char addr = '0';
+    bool query = false;
+    const char* hashFile = nullptr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:qh:")) != -1) {
+        switch (opt) {
+            case 'a': addr = char('0' + atoi(optarg)); break;
+            case 'q': query = true; break;
+            case 'h': hashFile = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-a address] [-q] [-h hashes] image\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-a address] [-q] [-h hashes] image\n", argv[0]);
+        return 1;
+    }
+
+    std::ifstream file(argv[optind], std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "can't open '%s'\n", argv[optind]);
+        return 1;
+    }
+    std::vector<uint8_t> image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    size_t numPages = (image.size() + PageSize - 1) / PageSize;
+    // 'H' and its reply number pages with one byte
+    if (numPages == 0 || numPages > 255) {
+        fprintf(stderr, "image must be 1 to %zu bytes\n", 255 * PageSize);
+        return 1;
+    }
+
+    // The device hashes whole pages, so the last one is filled out the way
+    // erased EEPROM reads, and sent whole
+    image.resize(numPages * PageSize, 0xff);
+
+    std::string out;
+    if (query) {
+        appendPacket(out, addr, 'H', { 0, uint8_t(numPages) });
+        fwrite(out.data(), 1, out.size(), stdout);
+        return 0;
+    }
+
+    // Lines which aren't hashes are other console output, so skip them
+    std::map<size_t, uint16_t> hashes;
+    if (hashFile) {
+        FILE* f = fopen(hashFile, "r");
+        if (!f) {
+            fprintf(stderr, "can't open '%s'\n", hashFile);
+            return 1;
+        }
+        char line[128];
+        while (fgets(line, sizeof(line), f)) {
+            unsigned page;
+            unsigned hash;
+            if (sscanf(line, "H %u %x", &page, &hash) == 2) {
+                hashes[page] = uint16_t(hash);
+            }
+        }
+        fclose(f);
+    }
+
+    uint32_t changed = 0;
+    for (size_t page = 0; page < numPages; ++page) {
+        auto it = hashes.find(page);
+        if (it != hashes.end() && it->second == pageHash(image, page)) {
+            continue;
+        }
+
+        size_t start = page * PageSize;
+        std::vector<uint8_t> payload = { uint8_t(start >> 8), uint8_t(start) };
+        payload.insert(payload.end(), image.begin() + start, image.begin() + start + PageSize);
+        appendPacket(out, addr, 'W', payload);
+        changed++;
+    }
+
+    fwrite(out.data(), 1, out.size(), stdout);
+    fprintf(stderr, "pages=%zu changed=%u bytes=%zu\n", numPages, changed, out.size());
+    return 0;
+}
@@ -12,92 +12,149 @@
 #include "MacWiFiPortal.h"
 #include "tigr.h"
 
-#include <numbers>
+#include <atomic>
 #include <cmath>
-#include <condition_variable>
+#include <cstring>
+#include <numbers>
+#include <vector>
 
 mil::MacWiFiPortal portal;
 
 static const char* TAG = "PostLightController";
 
 static constexpr double PI = std::numbers::pi;
-static constexpr int LEDsPerRing = 8;
-static constexpr double AnglePerLED = 2 * PI / LEDsPerRing;
 static constexpr int LEDRadius = 10;
-static constexpr int RingCount = 7;
+static constexpr int MaxRingsPerRow = 10;
 static constexpr int RingSize = 80;
 static constexpr int Spacing = 50;
-static constexpr int WindowWidth = RingSize * RingCount + Spacing * (RingCount + 1);
-static constexpr int WindowHeight = RingSize + Spacing * 2;
 
-static void polarToCartesian(double angle, int radius, int& x, int& y)
+// Update the window at least this often, even with nothing new to show, so
+// it keeps handling input
+static constexpr uint32_t MaxUpdateInterval = 100;
+
+// Hands frames from the render callback (on the controller's thread) to
+// the UI without locking. The producer fills its back buffer and swaps it
+// with the middle one. The consumer swaps the middle one with its front
+// buffer when there's a new frame. Neither ever waits for the other and
+// the UI only sees whole frames.
+class FrameHandoff
 {
-    x = std::cos(angle) * radius;
-    y = std::sin(angle) * radius;
-}
+public:
+    uint32_t* back() { return _buffers[_back]; }
+    
+    void publish(uint16_t count)
+    {
+        _counts[_back] = count;
+        _back = _middle.exchange(_back | Fresh, std::memory_order_acq_rel) & Index;
+    }
+    
+    // Returns nullptr if there's been no new frame since the last call
+    const uint32_t* acquire(uint16_t& count)
+    {
+        if (!(_middle.load(std::memory_order_relaxed) & Fresh)) {
+            return nullptr;
+        }
+        _front = _middle.exchange(_front, std::memory_order_acq_rel) & Index;
+        count = _counts[_front];
+        return _buffers[_front];
+    }
 
-static void colorToRGB(uint32_t color, uint8_t& r, uint8_t& g, uint8_t& b)
+private:
+    static constexpr uint8_t Index = 0x03;
+    static constexpr uint8_t Fresh = 0x04;
+    
+    uint32_t _buffers[3][Topology::MaxPixels] = { };
+    uint16_t _counts[3] = { };
+    uint8_t _back = 0;
+    uint8_t _front = 1;
+    std::atomic<uint8_t> _middle { 2 };
+};
+
+struct LEDPosition
 {
-    r = (color >> 16) & 0xff;
-    g = (color >> 8) & 0xff;
-    b = color & 0xff;
-}
+    int16_t x;
+    int16_t y;
+};
 
-static void makeRing(Tigr* screen, const uint32_t* buffer, int centerX, int centerY)
+// Where each LED is drawn, in rings of pixelsPerPost, one ring per post,
+// and the size of the window they need. This only changes with the
+// topology so it's computed once when the window opens
+struct Geometry
 {
-    double angle = 0;
+    Geometry(const Topology& topology)
+    {
+        int ringsPerRow = (topology.numPosts() < MaxRingsPerRow) ? topology.numPosts() : MaxRingsPerRow;
+        int rows = (topology.numPosts() + ringsPerRow - 1) / ringsPerRow;
+        width = RingSize * ringsPerRow + Spacing * (ringsPerRow + 1);
+        height = RingSize * rows + Spacing * (rows + 1);
+        
+        positions.reserve(topology.numPixels());
+        for (int post = 0; post < topology.numPosts(); ++post) {
+            int centerX = RingSize / 2 + Spacing + (post % ringsPerRow) * (RingSize + Spacing);
+            int centerY = RingSize / 2 + Spacing + (post / ringsPerRow) * (RingSize + Spacing);
+            
+            for (int i = 0; i < topology.pixelsPerPost(); ++i) {
+                double angle = 2 * PI * i / topology.pixelsPerPost();
+                positions.push_back({ int16_t(centerX + std::cos(angle) * RingSize / 2),
+                                      int16_t(centerY + std::sin(angle) * RingSize / 2) });
+            }
+        }
+    }
     
-    for (int i = 0; i < LEDsPerRing; ++i) {
-        int x;
-        int y;
-        polarToCartesian(angle, RingSize / 2, x, y);
+    int width;
+    int height;
+    std::vector<LEDPosition> positions;
+};
+
+// Redraw the LEDs which changed since the last frame. Returns true if any did
+static bool drawChanged(Tigr* screen, const std::vector<LEDPosition>& positions, const uint32_t* buffer, uint16_t count, uint32_t* shown)
+{
+    bool changed = false;
+    
+    if (count > positions.size()) {
+        count = uint16_t(positions.size());
+    }
+    
+    for (uint16_t i = 0; i < count; ++i) {
         uint32_t color = buffer[i];
-        uint8_t r, g, b;
-        colorToRGB(color, r, g, b);
-        tigrFillCircle(screen, x + centerX, y + centerY, LEDRadius, tigrRGB(r, g, b));
-        angle += AnglePerLED;
+        if (color == shown[i]) {
+            continue;
+        }
+        shown[i] = color;
+        tigrFillCircle(screen, positions[i].x, positions[i].y, LEDRadius, tigrRGB((color >> 16) & 0xff, (color >> 8) & 0xff, color & 0xff));
+        changed = true;
     }
+    return changed;
 }
 
 int main(int argc, char * const argv[])
 {
-    static std::mutex _mutex;
-    static std::condition_variable _statusCond;
-    
-    std::thread::id myThreadId = std::this_thread::get_id();
-    
-    bool needRender = false;
+    // Frames can come as soon as the controller starts, before there's a window
+    static FrameHandoff handoff;
+    mil::System::setRenderCB([](const mil::Graphics* gfx)
+    {
+        uint16_t count = (gfx->width() < Topology::MaxPixels) ? uint16_t(gfx->width()) : Topology::MaxPixels;
+        memcpy(handoff.back(), gfx->getBuffer(), count * sizeof(uint32_t));
+        handoff.publish(count);
+    });
     
     while (true) {
+        PostLightController controller(&portal);
+        
+        controller.setup();
+        
+        Geometry geometry(controller.topology());
+
         mil::System::logI(TAG, "Opening tigr window");
 
-        Tigr* screen = tigrWindow(WindowWidth, WindowHeight, "PostLightController", TIGR_AUTO);
+        Tigr* screen = tigrWindow(geometry.width, geometry.height, "PostLightController", TIGR_AUTO);
+        tigrClear(screen, tigrRGBA(0x0, 0x00, 0x00, 0xff));
         
-        mil::System::setRenderCB([screen, &needRender, myThreadId](const mil::Graphics* gfx)
-        {
-            std::unique_lock<std::mutex> lk(_mutex);
-            const uint32_t* b = reinterpret_cast<const uint32_t*>(gfx->getBuffer());
-            tigrClear(screen, tigrRGBA(0x0, 0x00, 0x00, 0xff));
-
-            int16_t width = gfx->width();
-
-            int x = RingSize / 2 + Spacing;
-            for (int i = 0; i < RingCount; ++i) {
-                if (width >= LEDsPerRing) {
-                    makeRing(screen, b + LEDsPerRing * i, x, RingSize / 2 + Spacing);
-                }
-                x += RingSize + Spacing;
-                width -= LEDsPerRing;
-                if (width <= 0) {
-                    break;
-                }
-            }
-            needRender = true;
-        });
-
-        PostLightController controller(&portal);
+        // Everything starts out black, like the window
+        static uint32_t shown[Topology::MaxPixels];
+        memset(shown, 0, sizeof(shown));
         
-        controller.setup();
+        uint32_t lastUpdate = mil::System::millis();
         
         while (!tigrClosed(screen) && !tigrKeyDown(screen, TK_ESCAPE)) {
             if (mil::System::isRestarting()) {
@@ -105,12 +162,13 @@ int main(int argc, char * const argv[])
             }
             
             controller.loop();
-            {
-                std::unique_lock<std::mutex> lk(_mutex);
-                if (needRender) {
-                    needRender = false;
-                    tigrUpdate(screen);
-               }
+
+            uint16_t count;
+            const uint32_t* buffer = handoff.acquire(count);
+            bool changed = buffer && drawChanged(screen, geometry.positions, buffer, count, shown);
+            if (changed || mil::System::millis() - lastUpdate >= MaxUpdateInterval) {
+                tigrUpdate(screen);
+                lastUpdate = mil::System::millis();
             }
             mil::System::delay(10);
         }